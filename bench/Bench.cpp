@@ -0,0 +1,473 @@
+//------------------------------------------------------------------------------
+// Bench.cpp
+//------------------------------------------------------------------------------
+// Windowless microbenchmarks for the game's hot paths. Results are written to
+// stdout as JSON so runs can be diffed across commits.
+//
+// Usage: ae-asteroids-bench [--data <dir>] [--filter <substring>] [--memory]
+//------------------------------------------------------------------------------
+// Headers
+//------------------------------------------------------------------------------
+#include "Game.h"
+#include "Components.h"
+#include "Memory.h"
+#include "Simplify.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+const ae::Tag TAG_BENCH = "bench";
+
+//------------------------------------------------------------------------------
+// Harness
+//------------------------------------------------------------------------------
+struct BenchResult
+{
+	ae::Str64 name;
+	uint32_t items = 0;
+	uint32_t iterations = 0;
+	double seconds = 0.0;
+	uint64_t heapAllocations = 0; // Across all timed iterations
+};
+
+ae::Array< BenchResult > g_results = TAG_BENCH;
+const char* g_filter = nullptr;
+
+// Runs fn until at least kMinTime has passed, fn should process 'items' things
+template< typename Fn >
+void Bench( const char* name, uint32_t items, Fn fn )
+{
+	if ( g_filter && !strstr( name, g_filter ) )
+	{
+		return;
+	}
+	const double kMinTime = 0.25;
+	const uint32_t kMinIterations = 3;
+	fn(); // Warm up
+	
+	using Clock = std::chrono::steady_clock;
+	BenchResult result;
+	result.name = name;
+	result.items = items;
+	// Per-frame work is expected to make no heap allocations once warm
+	const uint64_t heapAllocations = GetGameAllocator().GetHeapAllocations();
+	Clock::time_point start = Clock::now();
+	do
+	{
+		fn();
+		result.iterations++;
+		result.seconds = std::chrono::duration< double >( Clock::now() - start ).count();
+	} while ( result.seconds < kMinTime || result.iterations < kMinIterations );
+	result.heapAllocations = GetGameAllocator().GetHeapAllocations() - heapAllocations;
+	g_results.Append( result );
+}
+
+void WriteResults( FILE* out )
+{
+	fprintf( out, "{\n\t\"benchmarks\": [\n" );
+	for ( uint32_t i = 0; i < g_results.Length(); i++ )
+	{
+		const BenchResult& r = g_results[ i ];
+		double nsPerIteration = r.seconds * 1e9 / r.iterations;
+		double nsPerItem = r.items ? nsPerIteration / r.items : nsPerIteration;
+		double heapAllocationsPerIteration = (double)r.heapAllocations / r.iterations;
+		fprintf( out, "\t\t{ \"name\": \"%s\", \"items\": %u, \"iterations\": %u, \"ns_per_iteration\": %.1f, \"ns_per_item\": %.3f, \"heap_allocs_per_iteration\": %.2f }%s\n",
+			r.name.c_str(), r.items, r.iterations, nsPerIteration, nsPerItem, heapAllocationsPerIteration, ( i + 1 < g_results.Length() ) ? "," : "" );
+	}
+	fprintf( out, "\t],\n" );
+	
+	// Storage cost of each component, entt adds a sparse set entry per component on top
+	const struct { const char* name; uint32_t size; } kComponents[] =
+	{
+		{ "Transform", sizeof(Transform) },
+		{ "Physics", sizeof(Physics) },
+		{ "Ship", sizeof(Ship) },
+		{ "Shooter", sizeof(Shooter) },
+		{ "Turret", sizeof(Turret) },
+		{ "AiShip", sizeof(AiShip) },
+		{ "Projectile", sizeof(Projectile) },
+		{ "Team", sizeof(Team) },
+		{ "Model", sizeof(Model) },
+	};
+	const uint32_t kComponentCount = sizeof(kComponents) / sizeof(*kComponents);
+	fprintf( out, "\t\"component_bytes\": {\n" );
+	for ( uint32_t i = 0; i < kComponentCount; i++ )
+	{
+		fprintf( out, "\t\t\"%s\": %u%s\n", kComponents[ i ].name, kComponents[ i ].size, ( i + 1 < kComponentCount ) ? "," : "" );
+	}
+	fprintf( out, "\t},\n" );
+	const uint32_t projectileBytes = sizeof(Transform) + sizeof(Physics) + sizeof(Projectile) + sizeof(Team) + sizeof(Model);
+	fprintf( out, "\t\"projectile_bytes\": %u\n}\n", projectileBytes );
+}
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+// Random triangles spanning z=0 so every one of them produces a collision line
+void GenerateSlabMesh( ae::Array< Vertex >* vertices, ae::Array< uint16_t >* indices, uint32_t triCount, float extent )
+{
+	vertices->Clear();
+	indices->Clear();
+	for ( uint32_t i = 0; i < triCount; i++ )
+	{
+		ae::Vec3 c( ae::Random( -extent, extent ), ae::Random( -extent, extent ), 0.0f );
+		for ( uint32_t j = 0; j < 3; j++ )
+		{
+			Vertex v;
+			v.pos = ae::Vec4( c.x + ae::Random( -1.0f, 1.0f ), c.y + ae::Random( -1.0f, 1.0f ), ( j == 0 ) ? 1.0f : -1.0f, 1.0f );
+			v.normal = ae::Vec4( 0.0f, 0.0f, 1.0f, 0.0f );
+			v.color = ae::Vec4( 1.0f );
+			indices->Append( (uint16_t)vertices->Length() );
+			vertices->Append( v );
+		}
+	}
+}
+
+entt::entity CreateBody( entt::registry& registry, ae::Vec3 pos )
+{
+	entt::entity entity = registry.create();
+	Transform& transform = registry.emplace< Transform >( entity );
+	transform.SetPosition( pos );
+	Physics& physics = registry.emplace< Physics >( entity );
+	physics.vel = ae::Vec3( ae::Random( -1.0f, 1.0f ), ae::Random( -1.0f, 1.0f ), 0.0f );
+	physics.rotationVel = ae::Random( -1.0f, 1.0f );
+	physics.moveDrag = 0.7f;
+	physics.rotationDrag = 1.7f;
+	return entity;
+}
+
+//------------------------------------------------------------------------------
+// Benchmarks
+//------------------------------------------------------------------------------
+void BenchLevel( ResourceManager* resources )
+{
+	const uint32_t kTriCounts[] = { 1000, 10000 };
+	for ( uint32_t triCount : kTriCounts )
+	{
+		char name[ 64 ];
+		snprintf( name, sizeof(name), "slab%u", triCount );
+		ae::Array< Vertex > vertices = TAG_BENCH;
+		ae::Array< uint16_t > indices = TAG_BENCH;
+		GenerateSlabMesh( &vertices, &indices, triCount, 50.0f );
+		MeshHandle meshHandle = resources->CreateMesh( name, &vertices, &indices );
+		const MeshResource& mesh = *resources->Get( meshHandle );
+		
+		ae::Vec3 t[ 3 ];
+		snprintf( name, sizeof(name), "TrianglePlaneIntersection/%u", triCount );
+		Bench( name, triCount, [&]()
+		{
+			ae::Vec3 p0, p1;
+			for ( uint32_t i = 0; i < triCount; i++ )
+			{
+				const uint16_t* indices = &mesh.indices[ i * 3 ];
+				t[ 0 ] = mesh.vertices[ indices[ 0 ] ].pos.GetXYZ();
+				t[ 1 ] = mesh.vertices[ indices[ 1 ] ].pos.GetXYZ();
+				t[ 2 ] = mesh.vertices[ indices[ 2 ] ].pos.GetXYZ();
+				TrianglePlaneIntersection( ae::Vec3( 0.0f ), ae::Vec3( 0, 0, 1 ), t, &p0, &p1 );
+			}
+		} );
+		
+		snprintf( name, sizeof(name), "Level::AddMesh/%u", triCount );
+		Bench( name, triCount, [&]()
+		{
+			Level level;
+			level.AddMesh( resources, meshHandle, ae::Matrix4::Identity() );
+		} );
+		
+		Level level;
+		level.AddMesh( resources, meshHandle, ae::Matrix4::Identity() );
+		const uint32_t kBodyCount = 256;
+		Transform transforms[ kBodyCount ];
+		Physics physics[ kBodyCount ];
+		for ( uint32_t i = 0; i < kBodyCount; i++ )
+		{
+			transforms[ i ].SetPosition( ae::Vec3( ae::Random( -50.0f, 50.0f ), ae::Random( -50.0f, 50.0f ), 0.0f ) );
+			physics[ i ].collisionRadius = 0.5f;
+			physics[ i ].prevPos = transforms[ i ].GetPosition();
+		}
+		snprintf( name, sizeof(name), "Level::Test/%u", triCount );
+		Bench( name, kBodyCount, [&]()
+		{
+			for ( uint32_t i = 0; i < kBodyCount; i++ )
+			{
+				level.Test( &transforms[ i ], &physics[ i ] );
+			}
+		} );
+		
+		const uint32_t kRayCount = 1024;
+		ae::Array< Level::Ray > rays( TAG_BENCH, kRayCount );
+		ae::Array< Level::RayHit > hits( TAG_BENCH, kRayCount );
+		for ( uint32_t i = 0; i < kRayCount; i++ )
+		{
+			ae::Vec3 p0( ae::Random( -50.0f, 50.0f ), ae::Random( -50.0f, 50.0f ), 0.0f );
+			ae::Vec3 p1( ae::Random( -50.0f, 50.0f ), ae::Random( -50.0f, 50.0f ), 0.0f );
+			rays.Append( { p0, p1 } );
+			hits.Append( Level::RayHit() );
+		}
+		snprintf( name, sizeof(name), "Level::Raycast/%u", triCount );
+		Bench( name, kRayCount, [&]()
+		{
+			level.Raycast( rays.Begin(), hits.Begin(), kRayCount );
+		} );
+		resources->Release( meshHandle );
+	}
+}
+
+void BenchPhysics( Game* game )
+{
+	// The same bodies are added to a second registry that has no physics group,
+	// so each group benchmark is paired with the view it replaced. Its draw group
+	// is never sorted, so draws alternate between meshes.
+	const uint32_t kEntityCounts[] = { 10000, 100000 };
+	for ( uint32_t entityCount : kEntityCounts )
+	{
+		game->registry.clear();
+		entt::registry viewRegistry;
+		GetDrawGroup( viewRegistry );
+		for ( entt::registry* registry : { &game->registry, &viewRegistry } )
+		{
+			for ( uint32_t i = 0; i < entityCount; i++ )
+			{
+				entt::entity entity = CreateBody( *registry, ae::Vec3( ae::Random( -50.0f, 50.0f ), ae::Random( -50.0f, 50.0f ), 0.0f ) );
+				Model& model = registry->emplace< Model >( entity );
+				model.mesh = ( i % 2 ) ? game->shipMesh : game->asteroidMesh;
+				model.shader = game->shader;
+			}
+		}
+		
+		char name[ 64 ];
+		snprintf( name, sizeof(name), "Physics::Update/view/%u", entityCount );
+		Bench( name, entityCount, [&]()
+		{
+			for( auto [ entity, physics, transform ] : viewRegistry.view< Physics, Transform >( entt::exclude< Sleeping > ).each() )
+			{
+				physics.Update( game, transform, game->timeStep.GetTimeStep() );
+			}
+		} );
+		snprintf( name, sizeof(name), "Physics::Update/group/%u", entityCount );
+		Bench( name, entityCount, [&]()
+		{
+			for( auto [ entity, physics, transform ] : GetPhysicsGroup( game->registry ).each() )
+			{
+				physics.Update( game, transform, game->timeStep.GetTimeStep() );
+			}
+		} );
+		
+		RenderState state;
+		snprintf( name, sizeof(name), "DrawGroup/unsorted/%u", entityCount );
+		Bench( name, entityCount, [&]()
+		{
+			state.draws.Clear();
+			for( auto [ entity, model, transform ] : GetDrawGroup( viewRegistry ).each() )
+			{
+				model.Extract( &game->resources, transform, &state );
+			}
+			AE_ASSERT( state.draws.Length() == entityCount );
+		} );
+		snprintf( name, sizeof(name), "DrawGroup/sorted/%u", entityCount );
+		Bench( name, entityCount, [&]()
+		{
+			auto drawGroup = GetDrawGroup( game->registry );
+			drawGroup.sort< Model >( []( const Model& lhs, const Model& rhs ) { return lhs.mesh < rhs.mesh; }, entt::insertion_sort{} );
+			state.draws.Clear();
+			for( auto [ entity, model, transform ] : drawGroup.each() )
+			{
+				model.Extract( &game->resources, transform, &state );
+			}
+			AE_ASSERT( state.draws.Length() == entityCount );
+		} );
+	}
+	game->registry.clear();
+}
+
+void BenchTurrets( Game* game )
+{
+	const uint32_t kShipCount = 64;
+	const uint32_t kTurretCount = 1024;
+	game->registry.clear();
+	for ( uint32_t i = 0; i < kShipCount; i++ )
+	{
+		entt::entity entity = CreateBody( game->registry, ae::Vec3( ae::Random( -20.0f, 20.0f ), ae::Random( -20.0f, 20.0f ), 0.0f ) );
+		game->registry.emplace< Ship >( entity );
+		game->registry.emplace< Team >( entity ).teamId = TeamId::Player;
+	}
+	for ( uint32_t i = 0; i < kTurretCount; i++ )
+	{
+		entt::entity entity = CreateBody( game->registry, ae::Vec3( ae::Random( -20.0f, 20.0f ), ae::Random( -20.0f, 20.0f ), 0.0f ) );
+		game->registry.emplace< Turret >( entity );
+		game->registry.emplace< Team >( entity ).teamId = TeamId::Enemy;
+		game->registry.emplace< Shooter >( entity );
+	}
+	char name[ 64 ];
+	snprintf( name, sizeof(name), "Turret::Update/%ux%u", kTurretCount, kShipCount );
+	Bench( name, kTurretCount, [&]()
+	{
+		for( auto [ entity, turret ] : game->registry.view< Turret >().each() )
+		{
+			turret.Update( game, entity, game->timeStep.GetTimeStep() );
+		}
+	} );
+	game->registry.clear();
+}
+
+void BenchAiShips( Game* game )
+{
+	const uint32_t kShipCounts[] = { 1000, 10000 };
+	for ( uint32_t shipCount : kShipCounts )
+	{
+		// Two fleets at the density of the combat scenario
+		game->registry.clear();
+		const float extent = 44.0f * sqrtf( shipCount / 1000.0f );
+		for ( uint32_t i = 0; i < shipCount; i++ )
+		{
+			entt::entity entity = CreateBody( game->registry, ae::Vec3( ae::Random( -extent, extent ), ae::Random( -extent, extent ), 0.0f ) );
+			game->registry.emplace< Ship >( entity );
+			game->registry.emplace< AiShip >( entity );
+			game->registry.emplace< Shooter >( entity );
+			game->registry.emplace< Team >( entity ).teamId = ( i % 2 ) ? TeamId::Player : TeamId::Enemy;
+		}
+		AiController controller;
+		char name[ 64 ];
+		snprintf( name, sizeof(name), "AiController::Update/%u", shipCount );
+		Bench( name, shipCount, [&]()
+		{
+			controller.Update( game );
+		} );
+		AE_ASSERT( controller.GetUpdatedCount() == shipCount );
+	}
+	game->registry.clear();
+}
+
+void BenchSpawnKill( Game* game )
+{
+	const uint32_t kSpawnCount = 1000;
+	game->registry.clear();
+	entt::entity source = CreateBody( game->registry, ae::Vec3( 0.0f ) );
+	game->registry.emplace< Team >( source ).teamId = TeamId::Player;
+	ae::Array< entt::entity > spawned( TAG_BENCH, kSpawnCount );
+	Bench( "SpawnProjectile+Kill/1000", kSpawnCount, [&]()
+	{
+		for ( uint32_t i = 0; i < kSpawnCount; i++ )
+		{
+			game->SpawnProjectile( source, ae::Vec3( 0.6f, 0.3f, 0.0f ) );
+		}
+		game->ApplyCommands();
+		for( auto [ entity, projectile ] : game->registry.view< Projectile >().each() )
+		{
+			game->Kill( entity );
+		}
+		game->ApplyCommands();
+	} );
+	game->registry.clear();
+}
+
+void BenchTimers()
+{
+	// Steady state of 100k projectiles with a two second lifetime, so each tick
+	// expires and reschedules 1/120th of them
+	const uint32_t kTimerCount = 100000;
+	const uint32_t kLifetimeTicks = 120;
+	TimerWheel timers;
+	EventQueue< ExpireEvent > expired;
+	for ( uint32_t i = 0; i < kTimerCount; i++ )
+	{
+		timers.Schedule( (entt::entity)i, 1 + i % kLifetimeTicks );
+	}
+	Bench( "TimerWheel::Advance/100000", kTimerCount / kLifetimeTicks, [&]()
+	{
+		timers.Advance( &expired );
+		expired.Drain( [ &timers ]( const ExpireEvent& event )
+		{
+			timers.Schedule( event.entity, kLifetimeTicks );
+		} );
+	} );
+}
+
+void BenchImport( ae::FileSystem* file )
+{
+	const char* kFiles[] = { "cube.fbx", "diamond.fbx", "level0.fbx", "plane.fbx", "ship.fbx" };
+	for ( const char* path : kFiles )
+	{
+		ae::Array< Vertex > vertices = TAG_BENCH;
+		ae::Array< uint16_t > indices = TAG_BENCH;
+		if ( !MeshResource::Load( file, path, &vertices, &indices ) )
+		{
+			continue;
+		}
+		char name[ 64 ];
+		snprintf( name, sizeof(name), "MeshResource::Load/%s", path );
+		Bench( name, indices.Length() / 3, [&]()
+		{
+			vertices.Clear();
+			indices.Clear();
+			MeshResource::Load( file, path, &vertices, &indices );
+		} );
+		
+		const uint32_t triangleCount = indices.Length() / 3;
+		uint32_t targets[ MeshResource::kMaxLods - 1 ];
+		for ( uint32_t i = 0; i < MeshResource::kMaxLods - 1; i++ )
+		{
+			targets[ i ] = triangleCount >> ( i + 1 );
+		}
+		ae::Array< uint16_t > lodIndices[ MeshResource::kMaxLods - 1 ] = { TAG_BENCH, TAG_BENCH, TAG_BENCH };
+		snprintf( name, sizeof(name), "SimplifyMesh/%s", path );
+		Bench( name, triangleCount, [&]()
+		{
+			SimplifyMesh( vertices.Begin(), vertices.Length(), indices.Begin(), indices.Length(), targets, MeshResource::kMaxLods - 1, lodIndices );
+		} );
+	}
+}
+
+//------------------------------------------------------------------------------
+// Main
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+	ae::SetGlobalAllocator( &GetGameAllocator() );
+	const char* dataDir = "data";
+	bool logMemory = false;
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "--data" ) && i + 1 < argc )
+		{
+			dataDir = argv[ ++i ];
+		}
+		else if ( !strcmp( argv[ i ], "--filter" ) && i + 1 < argc )
+		{
+			g_filter = argv[ ++i ];
+		}
+		else if ( !strcmp( argv[ i ], "--memory" ) )
+		{
+			logMemory = true;
+		}
+	}
+	
+	// Only the parts of Game that don't need a window are used
+	Game* game = ae::New< Game >( TAG_BENCH );
+	game->timeStep.SetTimeStep( 1.0f / 60.0f );
+	game->file.Initialize( dataDir, "johnhues", "AE-Asteroids" );
+	game->resources.Initialize( &game->file, 0, false );
+	game->shader = game->resources.LoadShader( "default", kVertShader, kFragShader );
+	game->shipMesh = game->resources.CreateMesh( "ship", kTriangleVerts, kTriangleIndices, countof(kTriangleVerts), countof(kTriangleIndices) );
+	game->asteroidMesh = game->resources.CreateMesh( "asteroid", kAsteroidVerts, kAsteroidIndices, countof(kAsteroidVerts), countof(kAsteroidIndices) );
+	
+	BenchLevel( &game->resources );
+	BenchPhysics( game );
+	BenchTurrets( game );
+	BenchAiShips( game );
+	BenchSpawnKill( game );
+	BenchTimers();
+	BenchImport( &game->file );
+	
+	WriteResults( stdout );
+	if ( logMemory )
+	{
+		GetGameAllocator().LogStats();
+	}
+	game->resources.Release( game->shipMesh );
+	game->resources.Release( game->asteroidMesh );
+	game->resources.Release( game->shader );
+	game->resources.Terminate();
+	ae::Delete( game );
+	return 0;
+}
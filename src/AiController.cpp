@@ -0,0 +1,298 @@
+#include "AiController.h"
+#include "Components.h"
+#include "Game.h"
+
+// Cells are about half the default sensor range so a query covers a few cells,
+// but large battles are capped at 256x256
+const float kAiCellSize = 8.0f;
+const float kAiMaxCellsPerAxis = 256.0f;
+// Speed of projectiles relative to the shooter, see Game::SpawnProjectile()
+const float kAiProjectileSpeed = 15.0f;
+// Cosine of the largest angle to the aim direction that still thrusts or fires
+const float kAiThrustFacing = 0.5f;
+const float kAiFireFacing = 0.95f;
+// Sine of the angle to the aim direction below which the ship stops turning
+const float kAiTurnDeadZone = 0.05f;
+
+//------------------------------------------------------------------------------
+// AiController member functions
+//------------------------------------------------------------------------------
+void AiController::Update( Game* game )
+{
+	m_Gather( game );
+	if ( !m_agents.Length() )
+	{
+		return;
+	}
+	m_BuildGrid();
+
+	m_outputs.Clear();
+	m_outputs.Reserve( m_agents.Length() );
+	for ( uint32_t i = 0; i < m_agents.Length(); i++ )
+	{
+		m_outputs.Append( Output() );
+	}
+	// Each agent only reads the packed arrays and writes its own output
+	const uint32_t kChunkSize = 64;
+	game->jobs.ParallelFor( m_agents.Length(), kChunkSize, [ this ]( uint32_t begin, uint32_t end, uint32_t threadIndex )
+	{
+		for ( uint32_t i = begin; i < end; i++ )
+		{
+			m_Steer( i );
+		}
+	} );
+
+	m_Apply( game );
+}
+
+void AiController::m_Gather( Game* game )
+{
+	entt::registry& registry = game->registry;
+	m_entities.Clear();
+	m_positions.Clear();
+	m_velocities.Clear();
+	m_kinds.Clear();
+	m_teams.Clear();
+	m_agents.Clear();
+
+	auto addContact = [ this ]( entt::entity entity, const Transform& transform, const Physics& physics, Kind kind, TeamId teamId )
+	{
+		m_entities.Append( entity );
+		m_positions.Append( transform.GetPosition().GetXY() );
+		m_velocities.Append( physics.vel.GetXY() );
+		m_kinds.Append( kind );
+		m_teams.Append( (uint8_t)teamId );
+		return m_entities.Length() - 1;
+	};
+	for ( auto [ entity, ship, transform, physics, team ] : registry.view< Ship, Transform, Physics, Team >().each() )
+	{
+		uint32_t contact = addContact( entity, transform, physics, Kind::Ship, team.teamId );
+		const AiShip* ai = registry.try_get< AiShip >( entity );
+		const float dt = ai ? game->GetUpdateDt( entity ) : 0.0f;
+		if ( !dt )
+		{
+			continue;
+		}
+		Agent& agent = m_agents.Append( Agent() );
+		agent.contact = contact;
+		agent.forward = transform.GetForward().GetXY().SafeNormalizeCopy();
+		agent.dt = dt;
+		agent.speed = ship.speed;
+		agent.rotationSpeed = ship.rotationSpeed;
+		agent.sensorRange = ai->sensorRange;
+		agent.attackRange = ai->attackRange;
+		agent.evadeRange = ai->evadeRange;
+		agent.prevTarget = ai->target;
+		agent.targetVisible = ai->targetVisible;
+	}
+	if ( !m_agents.Length() )
+	{
+		return;
+	}
+	for ( auto [ entity, asteroid, transform, physics ] : registry.view< Asteroid, Transform, Physics >().each() )
+	{
+		addContact( entity, transform, physics, Kind::Asteroid, TeamId::None );
+	}
+	for ( auto [ entity, projectile, transform, physics, team ] : registry.view< Projectile, Transform, Physics, Team >().each() )
+	{
+		addContact( entity, transform, physics, Kind::Projectile, team.teamId );
+	}
+}
+
+void AiController::m_BuildGrid()
+{
+	ae::Vec2 min( ae::MaxValue< float >() );
+	ae::Vec2 max( -ae::MaxValue< float >() );
+	for ( ae::Vec2 p : m_positions )
+	{
+		min.x = ae::Min( min.x, p.x );
+		min.y = ae::Min( min.y, p.y );
+		max.x = ae::Max( max.x, p.x );
+		max.y = ae::Max( max.y, p.y );
+	}
+	ae::Vec2 size = max - min;
+	m_gridCellSize = ae::Max( kAiCellSize, ae::Max( size.x, size.y ) / kAiMaxCellsPerAxis );
+	m_gridMin = min;
+	m_gridWidth = (int32_t)( size.x / m_gridCellSize ) + 1;
+	m_gridHeight = (int32_t)( size.y / m_gridCellSize ) + 1;
+	const uint32_t cellCount = m_gridWidth * m_gridHeight;
+
+	// Count contacts per cell, convert counts to start offsets, then scatter
+	m_gridCellStart.Clear();
+	m_gridCellStart.Reserve( cellCount + 1 );
+	for ( uint32_t i = 0; i < cellCount + 1; i++ )
+	{
+		m_gridCellStart.Append( 0 );
+	}
+	auto getCell = [ this ]( ae::Vec2 p )
+	{
+		const int32_t x = ae::Min( (int32_t)( ( p.x - m_gridMin.x ) / m_gridCellSize ), m_gridWidth - 1 );
+		const int32_t y = ae::Min( (int32_t)( ( p.y - m_gridMin.y ) / m_gridCellSize ), m_gridHeight - 1 );
+		return (uint32_t)( y * m_gridWidth + x );
+	};
+	for ( ae::Vec2 p : m_positions )
+	{
+		m_gridCellStart[ getCell( p ) + 1 ]++;
+	}
+	for ( uint32_t i = 0; i < cellCount; i++ )
+	{
+		m_gridCellStart[ i + 1 ] += m_gridCellStart[ i ];
+	}
+	m_gridCursor.Clear();
+	m_gridCursor.Append( m_gridCellStart.Begin(), cellCount );
+	m_gridContacts.Clear();
+	m_gridContacts.Reserve( m_positions.Length() );
+	for ( uint32_t i = 0; i < m_positions.Length(); i++ )
+	{
+		m_gridContacts.Append( 0 );
+	}
+	for ( uint32_t i = 0; i < m_positions.Length(); i++ )
+	{
+		m_gridContacts[ m_gridCursor[ getCell( m_positions[ i ] ) ]++ ] = i;
+	}
+}
+
+void AiController::m_Steer( uint32_t agentIndex )
+{
+	const Agent& agent = m_agents[ agentIndex ];
+	const ae::Vec2 pos = m_positions[ agent.contact ];
+	const ae::Vec2 vel = m_velocities[ agent.contact ];
+	const uint8_t team = m_teams[ agent.contact ];
+	const float evadeRangeSq = agent.evadeRange * agent.evadeRange;
+
+	// Nearest enemy ship, preferring last tick's target while it is in range so
+	// ships don't keep switching between targets at similar distances
+	int32_t target = -1;
+	float targetDistanceSq = agent.sensorRange * agent.sensorRange;
+	bool keptTarget = false;
+	// Pushes away from nearby allies, asteroids and enemy projectiles that are
+	// closing in, each weighted from 0 at evade range up to 1 at the ship's center.
+	// Allies only keep ships spread out, the others are threats.
+	ae::Vec2 avoid( 0.0f );
+	bool threatened = false;
+
+	const int32_t x0 = ae::Max( (int32_t)floorf( ( pos.x - agent.sensorRange - m_gridMin.x ) / m_gridCellSize ), 0 );
+	const int32_t y0 = ae::Max( (int32_t)floorf( ( pos.y - agent.sensorRange - m_gridMin.y ) / m_gridCellSize ), 0 );
+	const int32_t x1 = ae::Min( (int32_t)floorf( ( pos.x + agent.sensorRange - m_gridMin.x ) / m_gridCellSize ), m_gridWidth - 1 );
+	const int32_t y1 = ae::Min( (int32_t)floorf( ( pos.y + agent.sensorRange - m_gridMin.y ) / m_gridCellSize ), m_gridHeight - 1 );
+	for ( int32_t y = y0; y <= y1; y++ )
+	{
+		const uint32_t rowStart = y * m_gridWidth;
+		const uint32_t* contacts = m_gridContacts.Begin();
+		const uint32_t end = m_gridCellStart[ rowStart + x1 + 1 ];
+		// Cells in a row are contiguous, so the whole span is scanned at once
+		for ( uint32_t i = m_gridCellStart[ rowStart + x0 ]; i < end; i++ )
+		{
+			const uint32_t contact = contacts[ i ];
+			if ( contact == agent.contact )
+			{
+				continue;
+			}
+			const ae::Vec2 diff = m_positions[ contact ] - pos;
+			const float distanceSq = diff.LengthSquared();
+			const Kind kind = m_kinds[ contact ];
+			const bool enemy = ( m_teams[ contact ] != team );
+			if ( kind == Kind::Ship && enemy )
+			{
+				if ( keptTarget )
+				{
+					continue;
+				}
+				if ( m_entities[ contact ] == agent.prevTarget && distanceSq < agent.sensorRange * agent.sensorRange )
+				{
+					target = contact;
+					keptTarget = true;
+				}
+				else if ( distanceSq < targetDistanceSq )
+				{
+					target = contact;
+					targetDistanceSq = distanceSq;
+				}
+			}
+			else if ( distanceSq < evadeRangeSq && distanceSq > 0.0f )
+			{
+				if ( kind == Kind::Projectile && ( !enemy || diff.Dot( m_velocities[ contact ] - vel ) >= 0.0f ) )
+				{
+					// Friendly fire and projectiles moving away are ignored
+					continue;
+				}
+				const float distance = sqrtf( distanceSq );
+				avoid -= diff * ( ( agent.evadeRange - distance ) / ( agent.evadeRange * distance ) );
+				threatened = threatened || ( kind != Kind::Ship );
+			}
+		}
+	}
+
+	Output& output = m_outputs[ agentIndex ];
+	output.accel = ae::Vec2( 0.0f );
+	output.rotationDelta = 0.0f;
+	output.target = target;
+	output.state = AiShip::Idle;
+	output.fire = false;
+
+	// Avoidance is blended into the heading rather than replacing it, so ships
+	// in a tight formation still close in on their targets
+	ae::Vec2 aim( 0.0f );
+	if ( target >= 0 )
+	{
+		// Lead the target by the time a projectile takes to reach it
+		const ae::Vec2 toTarget = m_positions[ target ] - pos;
+		const float distance = toTarget.Length();
+		aim = ( toTarget + ( m_velocities[ target ] - vel ) * ( distance / kAiProjectileSpeed ) ).SafeNormalizeCopy();
+		output.state = ( distance > agent.attackRange ) ? AiShip::Seek : AiShip::Attack;
+	}
+	else if ( threatened )
+	{
+		output.state = AiShip::Evade;
+	}
+	const ae::Vec2 desired = ( aim + avoid ).SafeNormalizeCopy();
+	if ( desired == ae::Vec2( 0.0f ) )
+	{
+		// Idle ships with nothing nearby coast to a stop and can go to sleep
+		return;
+	}
+
+	// Same controls as the local ship, thrust along the facing and turn at a fixed rate
+	const float turn = agent.forward.x * desired.y - agent.forward.y * desired.x;
+	if ( turn > kAiTurnDeadZone )
+	{
+		output.rotationDelta = agent.rotationSpeed * agent.dt;
+	}
+	else if ( turn < -kAiTurnDeadZone )
+	{
+		output.rotationDelta = -agent.rotationSpeed * agent.dt;
+	}
+	// Attacking ships hold position unless something is about to hit them
+	if ( ( output.state != AiShip::Attack || threatened ) && agent.forward.Dot( desired ) > kAiThrustFacing )
+	{
+		output.accel = agent.forward * agent.speed;
+	}
+	// Visibility was checked against last tick's target
+	const bool visible = agent.targetVisible && target >= 0 && m_entities[ target ] == agent.prevTarget;
+	output.fire = ( output.state == AiShip::Attack && visible && agent.forward.Dot( aim ) > kAiFireFacing );
+}
+
+void AiController::m_Apply( Game* game )
+{
+	entt::registry& registry = game->registry;
+	for ( uint32_t i = 0; i < m_agents.Length(); i++ )
+	{
+		const Output& output = m_outputs[ i ];
+		const entt::entity entity = m_entities[ m_agents[ i ].contact ];
+		AiShip& ai = registry.get< AiShip >( entity );
+		ai.state = (AiShip::State)output.state;
+		ai.target = ( output.target >= 0 ) ? m_entities[ output.target ] : entt::null;
+
+		Physics& physics = registry.get< Physics >( entity );
+		physics.accel = ae::Vec3( output.accel, 0.0f );
+		physics.rotationVel += output.rotationDelta;
+		if ( output.accel != ae::Vec2( 0.0f ) || output.rotationDelta )
+		{
+			game->Wake( entity );
+		}
+		if ( Shooter* shooter = registry.try_get< Shooter >( entity ) )
+		{
+			shooter->fire = output.fire;
+		}
+	}
+}
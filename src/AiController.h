@@ -0,0 +1,79 @@
+#ifndef ASTEROIDS_AICONTROLLER_H
+#define ASTEROIDS_AICONTROLLER_H
+
+#include "ae/aether.h"
+#include "entt/entt.hpp"
+
+const ae::Tag TAG_AI = "ai";
+
+//------------------------------------------------------------------------------
+// AiController class
+//------------------------------------------------------------------------------
+// Steers every ship with an AiShip component in one batch per tick. Ships,
+// asteroids and projectiles are gathered into packed arrays and bucketed into
+// a uniform grid. Each due AI ship then queries its neighbors and picks a
+// behavior on the job system without touching the registry. Finally the
+// results are written back to Physics, Shooter and AiShip on the calling thread.
+class AiController
+{
+public:
+	void Update( class Game* game );
+	// AI ships that were due in the last Update()
+	uint32_t GetUpdatedCount() const { return m_agents.Length(); }
+
+private:
+	enum class Kind : uint8_t
+	{
+		Ship,
+		Asteroid,
+		Projectile
+	};
+	// Inputs for each AI ship that is due this tick
+	struct Agent
+	{
+		uint32_t contact; // Index into the contact arrays
+		ae::Vec2 forward;
+		float dt;
+		float speed;
+		float rotationSpeed;
+		float sensorRange;
+		float attackRange;
+		float evadeRange;
+		entt::entity prevTarget;
+		bool targetVisible;
+	};
+	struct Output
+	{
+		ae::Vec2 accel;
+		float rotationDelta;
+		int32_t target; // Contact index, or -1
+		uint32_t state; // AiShip::State
+		bool fire;
+	};
+	void m_Gather( Game* game );
+	void m_BuildGrid();
+	void m_Steer( uint32_t agentIndex );
+	void m_Apply( Game* game );
+
+	// Everything the AI ships can sense, one entry per contact
+	ae::Array< entt::entity > m_entities = TAG_AI;
+	ae::Array< ae::Vec2 > m_positions = TAG_AI;
+	ae::Array< ae::Vec2 > m_velocities = TAG_AI;
+	ae::Array< Kind > m_kinds = TAG_AI;
+	ae::Array< uint8_t > m_teams = TAG_AI; // TeamId
+	// Indexed in parallel
+	ae::Array< Agent > m_agents = TAG_AI;
+	ae::Array< Output > m_outputs = TAG_AI;
+
+	// Contacts in cell i are m_gridContacts[ m_gridCellStart[ i ] ] to
+	// m_gridContacts[ m_gridCellStart[ i + 1 ] ]
+	ae::Vec2 m_gridMin = ae::Vec2( 0.0f );
+	float m_gridCellSize = 1.0f;
+	int32_t m_gridWidth = 0;
+	int32_t m_gridHeight = 0;
+	ae::Array< uint32_t > m_gridCellStart = TAG_AI;
+	ae::Array< uint32_t > m_gridContacts = TAG_AI;
+	ae::Array< uint32_t > m_gridCursor = TAG_AI;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "CommandBuffer.h"
+#include <algorithm>
+
+std::atomic< uint32_t > CommandBuffer::s_poolTypeCount( 0 );
+
+//------------------------------------------------------------------------------
+// CommandBuffer member functions
+//------------------------------------------------------------------------------
+CommandBuffer::~CommandBuffer()
+{
+	for ( PoolBase* pool : m_pools )
+	{
+		if ( pool )
+		{
+			ae::Delete( pool );
+		}
+	}
+}
+
+uint32_t CommandBuffer::Create()
+{
+	return m_createCount++;
+}
+
+void CommandBuffer::Destroy( entt::entity entity )
+{
+	m_destroy.Append( entity );
+}
+
+void CommandBuffer::Apply( entt::registry* registry )
+{
+	if ( m_createCount )
+	{
+		m_created.Clear();
+		for ( uint32_t i = 0; i < m_createCount; i++ )
+		{
+			m_created.Append( entt::null );
+		}
+		registry->create( m_created.begin(), m_created.end() );
+		for ( PoolBase* pool : m_pools )
+		{
+			if ( pool )
+			{
+				pool->Apply( registry, m_created.begin() );
+			}
+		}
+		m_createCount = 0;
+	}
+
+	if ( m_destroy.Length() )
+	{
+		entt::entity* begin = m_destroy.begin();
+		entt::entity* end = m_destroy.end();
+		std::sort( begin, end );
+		end = std::unique( begin, end );
+		end = std::remove_if( begin, end, [ registry ]( entt::entity e ) { return !registry->valid( e ); } );
+		registry->destroy( begin, end );
+		m_destroy.Clear();
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef ASTEROIDS_COMMANDBUFFER_H
+#define ASTEROIDS_COMMANDBUFFER_H
+
+#include "ae/aether.h"
+#include "entt/entt.hpp"
+#include <atomic>
+
+const ae::Tag TAG_COMMANDS = "commands";
+
+//------------------------------------------------------------------------------
+// CommandBuffer class
+//------------------------------------------------------------------------------
+// Records structural changes (create, emplace and destroy) so that systems can
+// request them while views are being iterated. Nothing touches the registry
+// until Apply() is called at a sync point. A CommandBuffer is not thread safe,
+// each thread should record into its own buffer.
+class CommandBuffer
+{
+public:
+	CommandBuffer() = default;
+	~CommandBuffer();
+	CommandBuffer( const CommandBuffer& ) = delete;
+	CommandBuffer& operator=( const CommandBuffer& ) = delete;
+
+	// Returns an id that can be passed to Emplace() on this buffer. The entity is
+	// created when the buffer is applied.
+	uint32_t Create();
+	template< typename T > void Emplace( uint32_t id, const T& component );
+	// Destroying the same entity more than once is allowed
+	void Destroy( entt::entity entity );
+
+	// Creates all pending entities in one batch, emplaces their components one
+	// type at a time, then destroys all pending entities in sorted order
+	void Apply( entt::registry* registry );
+	bool IsEmpty() const { return !m_createCount && !m_destroy.Length(); }
+
+private:
+	struct PoolBase
+	{
+		virtual ~PoolBase() {}
+		virtual void Apply( entt::registry* registry, const entt::entity* created ) = 0;
+	};
+	template< typename T >
+	struct Pool : public PoolBase
+	{
+		void Apply( entt::registry* registry, const entt::entity* created ) override;
+		ae::Array< uint32_t > ids = TAG_COMMANDS;
+		ae::Array< T > components = TAG_COMMANDS;
+	};
+	template< typename T > static uint32_t m_GetPoolIndex();
+	// Pool indices are assigned the first time each type is used, which may
+	// happen on several threads at once
+	static std::atomic< uint32_t > s_poolTypeCount;
+
+	uint32_t m_createCount = 0;
+	ae::Array< PoolBase* > m_pools = TAG_COMMANDS; // Indexed by m_GetPoolIndex(), may contain nulls
+	ae::Array< entt::entity > m_created = TAG_COMMANDS;
+	ae::Array< entt::entity > m_destroy = TAG_COMMANDS;
+};
+
+//------------------------------------------------------------------------------
+// CommandBuffer template member functions
+//------------------------------------------------------------------------------
+template< typename T >
+uint32_t CommandBuffer::m_GetPoolIndex()
+{
+	static const uint32_t s_index = s_poolTypeCount.fetch_add( 1 );
+	return s_index;
+}
+
+template< typename T >
+void CommandBuffer::Emplace( uint32_t id, const T& component )
+{
+	AE_ASSERT( id < m_createCount );
+	uint32_t index = m_GetPoolIndex< T >();
+	while ( m_pools.Length() <= index )
+	{
+		m_pools.Append( nullptr );
+	}
+	if ( !m_pools[ index ] )
+	{
+		m_pools[ index ] = ae::New< Pool< T > >( TAG_COMMANDS );
+	}
+	Pool< T >* pool = static_cast< Pool< T >* >( m_pools[ index ] );
+	pool->ids.Append( id );
+	pool->components.Append( component );
+}
+
+template< typename T >
+void CommandBuffer::Pool< T >::Apply( entt::registry* registry, const entt::entity* created )
+{
+	// Entities are usually given the same components in creation order, so the
+	// ids form contiguous runs that can be inserted in bulk
+	uint32_t count = ids.Length();
+	for ( uint32_t start = 0; start < count; )
+	{
+		uint32_t end = start + 1;
+		while ( end < count && ids[ end ] == ids[ end - 1 ] + 1 )
+		{
+			end++;
+		}
+		const entt::entity* first = created + ids[ start ];
+		registry->insert< T >( first, first + ( end - start ), components.begin() + start );
+		start = end;
+	}
+	ids.Clear();
+	components.Clear();
+}
+
+#endif
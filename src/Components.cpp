@@ -23,10 +23,8 @@ float Transform::GetRoll() const
 	return 0.0f;
 }
 
-void Physics::Update( Game* game, Transform& transform )
+void Physics::Update( Game* game, Transform& transform, float dt )
 {
-	const float dt = game->timeStep.GetDt();
-	
 	static float s_roll = 0.0f;
 	s_roll += rotationDrag * dt * 0.25f;
 	
@@ -35,6 +33,7 @@ void Physics::Update( Game* game, Transform& transform )
 	float yaw = transform.GetYaw();
 	float roll = s_roll;//transform.GetRoll();
 
+	prevPos = pos;
 	vel += accel * dt;
 	pos += vel * dt;
 	
@@ -51,6 +50,13 @@ void Physics::Update( Game* game, Transform& transform )
 	transform.transform *= ae::Matrix4::Scaling( scale );
 }
 
+bool Physics::IsResting() const
+{
+	const float kRestingSpeed = 0.01f;
+	const float kRestingRotationSpeed = 0.01f;
+	return accel == ae::Vec3( 0.0f ) && vel.LengthSquared() < kRestingSpeed * kRestingSpeed && ae::Abs( rotationVel ) < kRestingRotationSpeed;
+}
+
 
 void Ship::Update( Game* game, entt::entity entity, Transform& transform, Physics& physics )
 {
@@ -83,6 +89,10 @@ void Ship::Update( Game* game, entt::entity entity, Transform& transform, Physic
 	{
 		physics.rotationVel -= rotationSpeed * dt;
 	}
+	if ( physics.accel != ae::Vec3( 0.0f ) || input.Get( ae::Key::Left ) || input.Get( ae::Key::Right ) )
+	{
+		game->Wake( entity );
+	}
 	
 	Shooter& shooter = game->registry.get< Shooter >( entity );
 	shooter.fire = input.Get( ae::Key::Space );
@@ -96,11 +106,11 @@ void Shooter::Update( Game* game, entt::entity entity )
 	}
 	
 	double currentTime = ae::GetTime();
-	if ( m_lastFired + fireInterval < currentTime )
+	if ( lastFired + fireInterval < currentTime )
 	{
-		game->SpawnProjectile( entity, ae::Vec3( 0.6f, 0.3f, 0.0f ) );
-		game->SpawnProjectile( entity, ae::Vec3( -0.6f, 0.3f, 0.0f ) );
-		m_lastFired = currentTime;
+		game->fireEvents.Push( { entity, ae::Vec3( 0.6f, 0.3f, 0.0f ) } );
+		game->fireEvents.Push( { entity, ae::Vec3( -0.6f, 0.3f, 0.0f ) } );
+		lastFired = currentTime;
 	}
 }
 
@@ -131,25 +141,24 @@ void Camera::Update( Game* game, Transform& transform )
 //	camPos.y = ae::Max( camPos.y, -4.0f );
 	
 	transform.SetPosition( camPos );
-	game->worldToNdc = ae::Matrix4::ViewToProjection( 0.9f, game->render.GetAspectRatio(), 1.0f, 100.0f );
+	game->worldToNdc = ae::Matrix4::ViewToProjection( 0.9f, game->aspectRatio, 1.0f, 100.0f );
 	game->worldToNdc *= ae::Matrix4::WorldToView( camPos, ae::Vec3( 0, 0, -1 ), ae::Vec3( 0, 1, 0 ) );
 }
 
-void Asteroid::Update( Game* game, Transform& transform, Physics& physics )
+void Asteroid::Update( Game* game, entt::entity entity, Transform& transform, Physics& physics )
 {
-	if ( !game->IsOnScreen( transform.GetPosition() ) )
+	// Asteroids keep their velocity and reappear on the far side of the field, so
+	// the field stays evenly populated however large the scene is
+	ae::Vec3 pos = transform.GetPosition();
+	if ( game->WrapToAsteroidField( &pos ) )
 	{
-		transform.SetPosition( ae::Vec3( ae::Random( -1.0f, 1.0f ), ae::Random( -1.0f, 1.0f ), 0.0f ) );
-		
-		float angle = ae::Random( 0.0f, ae::TWO_PI );
-		float speed = ae::Random( 0.1f, 0.7f );
-		physics.vel = ae::Vec3( cosf( angle ), sinf( angle ), 0.0f ) * speed;
+		game->Wake( entity );
+		transform.SetPosition( pos );
 	}
 }
 
-void Turret::Update( Game* game, entt::entity entity )
+void Turret::Update( Game* game, entt::entity entity, float dt )
 {
-	float dt = game->timeStep.GetDt();
 	Transform& transform = game->registry.get< Transform >( entity );
 	Physics& physics = game->registry.get< Physics >( entity );
 	TeamId teamId = game->registry.get< Team >( entity ).teamId;
@@ -158,24 +167,33 @@ void Turret::Update( Game* game, entt::entity entity )
 	
 	float targetDistanceSq = ae::MaxValue< float >();
 	Transform* targetTransform = nullptr;
-	for( auto [ entity, ship, shipTransform, shipTeam ] : game->registry.view< Ship, Transform, Team >().each() )
+	entt::entity prevTarget = target;
+	target = entt::null;
+	for( auto [ shipEntity, ship, shipTransform, shipTeam ] : game->registry.view< Ship, Transform, Team >().each() )
 	{
 		if ( shipTeam.teamId != teamId )
 		{
 			float distanceSq = ( shipTransform.GetPosition() - transform.GetPosition() ).LengthSquared();
-			game->debugLines.AddDistanceCheck( shipTransform.GetPosition(), transform.GetPosition(), range );
+			if ( ae::DebugLines* debugLines = GetDebugLines() )
+			{
+				debugLines->AddDistanceCheck( shipTransform.GetPosition(), transform.GetPosition(), range );
+			}
 			if ( distanceSq <= rangeSq && distanceSq < targetDistanceSq )
 			{
 				targetTransform = &shipTransform;
 				targetDistanceSq = distanceSq;
+				target = shipEntity;
 			}
 		}
 	}
+	// Visibility was checked against last tick's target
+	bool visible = targetVisible && target == prevTarget;
 	
 	Shooter& shooter = game->registry.get< Shooter >( entity );
 	shooter.fire = false;
 	if ( targetTransform )
 	{
+		game->Wake( entity );
 		ae::Vec2 forward = transform.GetForward().GetXY().SafeNormalizeCopy();
 		ae::Vec2 diff = ( targetTransform->GetPosition() - transform.GetPosition() ).GetXY().SafeNormalizeCopy();
 		ae::Vec2 n( -forward.y, forward.x );
@@ -189,34 +207,29 @@ void Turret::Update( Game* game, entt::entity entity )
 			physics.rotationVel -= dt;
 		}
 		
-		if ( forward.Dot( diff ) > 0.4f )
+		if ( visible && forward.Dot( diff ) > 0.4f )
 		{
 			shooter.fire = true;
 		}
 	}
 }
 
-void Projectile::Update( Game* game, entt::entity entity )
+void Model::Extract( ResourceManager* resources, const Transform& transform, RenderState* stateOut )
 {
-	if ( killTime && killTime < ae::GetTime() )
+	const MeshResource* mesh = resources->Get( this->mesh );
+	const ae::Shader* shader = resources->Get( this->shader );
+	if ( !mesh || !shader )
 	{
-		game->Kill( entity );
+		return;
 	}
+	ae::Vec3 scale = transform.transform.GetScale();
+	float radius = mesh->GetRadius() * ae::Max( scale.x, ae::Max( scale.y, scale.z ) );
+	lod = mesh->SelectLod( GetProjectedRadius( stateOut->frame.worldToNdc, transform.GetPosition(), radius ), lod );
 	
-	Physics& physics = game->registry.get< Physics >( entity );
-	if ( physics.hit )
-	{
-		game->Kill( entity );
-	}
-}
-
-void Model::Draw( Game* game, const Transform& transform ) const
-{
-	ae::Matrix4 normalMatrix = transform.transform.GetNormalMatrix();
-	ae::UniformList uniformList;
-	uniformList.Set( "u_modelToNdc", game->worldToNdc * transform.transform );
-	uniformList.Set( "u_normalMatrix", normalMatrix );
-	uniformList.Set( "u_ambientLight", game->ambientLight.GetLinearRGB() );
-	uniformList.Set( "u_color", color.GetLinearRGB() );
-	mesh->vertexData.Render( shader, uniformList );
+	RenderState::Draw& draw = stateOut->draws.Append( RenderState::Draw() );
+	draw.transform = transform.transform;
+	draw.mesh = mesh;
+	draw.shader = shader;
+	draw.color = color.GetLinearRGB();
+	draw.lod = lod;
 }
@@ -2,10 +2,11 @@
 #define ASTEROIDS_COMPONENTS_H
 
 #include "ae/aether.h"
+#include "entt/entt.hpp"
 #include "Game.h"
-#include "Component.h"
+#include <type_traits>
 
-struct Transform : public Component
+struct Transform
 {
 	ae::Matrix4 transform = ae::Matrix4::Identity();
 	
@@ -17,11 +18,13 @@ struct Transform : public Component
 	float GetRoll() const;
 };
 
-struct Physics : public Component
+struct Physics
 {
-	void Update( class Game* game, Transform& transform );
+	void Update( class Game* game, Transform& transform, float dt );
 	
 	float GetSpeed() const { return vel.Length(); }
+	// No acceleration and only negligible motion left
+	bool IsResting() const;
 	
 	float moveDrag = 0.0f;
 	float rotationDrag = 0.0f;
@@ -31,10 +34,37 @@ struct Physics : public Component
 	float rotationVel = 0.0f;
 	
 	float collisionRadius = 0.0f;
-	bool hit = false;
+	ae::Vec3 prevPos = ae::Vec3( 0.0f ); // Position at the start of the current step, used for swept collision
+	uint32_t restingTicks = 0; // Consecutive ticks IsResting() has been true
+};
+
+// Entities far from the local ship and camera update less often. Turret,
+// AiShip, Shooter, Asteroid and Physics updates are skipped on ticks where the entity is
+// not due, and get the time since its last update when it is. Entities without
+// a SimLod always update at the full rate. See Game::m_UpdateSimLod().
+struct SimLod
+{
+	enum Tier : uint32_t
+	{
+		Full,
+		Medium,
+		Far,
+		TierCount
+	};
+	uint32_t tier = Full;
+	bool due = true; // Refreshed at the start of every tick
+	float dt = 0.0f; // Seconds since the previous update, valid when due
+	double lastTime = -1.0; // Game::GetSimTime() of the previous update
 };
 
-struct Ship : public Component
+// Bodies that have been resting for a while are moved out of the physics group
+// so they cost nothing per tick. Use Game::Wake() when changing their motion.
+struct Sleeping
+{
+	int32_t dummy;
+};
+
+struct Ship
 {
 	void Update( class Game* game, entt::entity entity, Transform& transform, Physics& physics );
 	
@@ -43,18 +73,37 @@ struct Ship : public Component
 	float rotationSpeed = 10.0f;
 };
 
-struct Shooter : public Component
+// Non-local ships steered in batches by AiController. Attacks the nearest
+// enemy ship in sensor range while steering away from allies, asteroids and
+// enemy projectiles within evade range. Evade is the state of a ship with no
+// target that is dodging an asteroid or projectile.
+struct AiShip
+{
+	enum State : uint32_t
+	{
+		Idle,
+		Seek,
+		Attack,
+		Evade
+	};
+	float sensorRange = 16.0f;
+	float attackRange = 8.0f;
+	float evadeRange = 2.5f;
+	State state = Idle;
+	entt::entity target = entt::null;
+	bool targetVisible = false; // Line of sight to target, refreshed in batches by Game
+};
+
+struct Shooter
 {
 	void Update( class Game* game, entt::entity entity );
 	
 	bool fire = false;
 	float fireInterval = 0.25f;
-	
-private:
-	double m_lastFired = 0.0;
+	double lastFired = 0.0;
 };
 
-struct Camera : public Component
+struct Camera
 {
 	void Update( class Game* game, Transform& transform );
 	
@@ -62,44 +111,80 @@ struct Camera : public Component
 	float zoomSnappiness = 0.05f;
 };
 
-struct Asteroid : public Component
+struct Asteroid
 {
-	void Update( class Game* game, Transform& transform, Physics& physics );
+	void Update( class Game* game, entt::entity entity, Transform& transform, Physics& physics );
 	
 	int32_t dummy;
 };
 
-struct Turret : public Component
+struct Turret
 {
-	void Update( class Game* game, entt::entity entity );
+	void Update( class Game* game, entt::entity entity, float dt );
 	
 	float range = 10.0f;
+	entt::entity target = entt::null;
+	bool targetVisible = false; // Line of sight to target, refreshed in batches by Game
 };
 
-struct Projectile : public Component
+// Projectiles are destroyed when they hit the level or their lifetime runs out,
+// see Game::m_ProcessEvents()
+struct Projectile
 {
-	void Update( class Game* game, entt::entity entity );
-	
-	double killTime = 0.0;
+	uint32_t lifetimeTicks = 0; // Scheduled on the timer wheel when the component is created
+	uint64_t expireTick = 0; // Set when scheduled, cancels the timer if destroyed early
 };
 
-struct Team : public Component
+struct Team
 {
 	TeamId teamId = TeamId::None;
 };
 
-struct Collision : public Component
+struct Collision
 {
 	int32_t dummy;
 };
 
-struct Model : public Component
+struct Model
 {
-	void Draw( class Game* game, const Transform& transform ) const;
+	// Picks an lod from the projected size of the mesh and adds a draw to the
+	// state. Nothing is drawn if the mesh or shader is no longer loaded.
+	void Extract( class ResourceManager* resources, const Transform& transform, struct RenderState* stateOut );
 	
-	const class MeshResource* mesh = nullptr;
-	const ae::Shader* shader = nullptr;
+	// Not reference counted, whoever spawns the model keeps the resources loaded
+	MeshHandle mesh;
+	ShaderHandle shader;
 	ae::Color color = ae::Color::White();
+	uint32_t lod = 0;
 };
 
+// Components are plain data so entt pools can be copied and processed in bulk
+static_assert( std::is_trivially_copyable_v< Transform > );
+static_assert( std::is_trivially_copyable_v< Physics > );
+static_assert( std::is_trivially_copyable_v< Sleeping > );
+static_assert( std::is_trivially_copyable_v< SimLod > );
+static_assert( std::is_trivially_copyable_v< Ship > );
+static_assert( std::is_trivially_copyable_v< AiShip > );
+static_assert( std::is_trivially_copyable_v< Shooter > );
+static_assert( std::is_trivially_copyable_v< Camera > );
+static_assert( std::is_trivially_copyable_v< Asteroid > );
+static_assert( std::is_trivially_copyable_v< Turret > );
+static_assert( std::is_trivially_copyable_v< Projectile > );
+static_assert( std::is_trivially_copyable_v< Team > );
+static_assert( std::is_trivially_copyable_v< Collision > );
+static_assert( std::is_trivially_copyable_v< Model > );
+
+// Owning groups keep their components packed in matching order, so the hot
+// loops iterate linearly instead of probing sparse sets. Everything must use
+// these so that the group definitions always agree.
+inline auto GetPhysicsGroup( entt::registry& registry )
+{
+	return registry.group< Physics, Transform >( entt::get<>, entt::exclude< Sleeping > );
+}
+
+inline auto GetDrawGroup( entt::registry& registry )
+{
+	return registry.group< Model >( entt::get< Transform > );
+}
+
 #endif
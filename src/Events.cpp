@@ -0,0 +1,69 @@
+#include "Events.h"
+
+//------------------------------------------------------------------------------
+// TimerWheel member functions
+//------------------------------------------------------------------------------
+uint64_t TimerWheel::Schedule( entt::entity entity, uint32_t ticks )
+{
+	ticks = ae::Max( ticks, 1u );
+	Timer timer;
+	timer.entity = entity;
+	timer.laps = ( ticks - 1 ) / kSlotCount;
+	m_slots[ ( m_tick + ticks ) % kSlotCount ].timers.Append( timer );
+	m_timerCount++;
+	return m_tick + ticks;
+}
+
+void TimerWheel::Cancel( entt::entity entity, uint64_t expireTick )
+{
+	if ( expireTick <= m_tick )
+	{
+		return;
+	}
+	// Only the slot the timer expires in needs to be searched, order within a
+	// slot doesn't matter
+	ae::Array< Timer >& timers = m_slots[ expireTick % kSlotCount ].timers;
+	for ( uint32_t i = 0; i < timers.Length(); i++ )
+	{
+		if ( timers[ i ].entity == entity )
+		{
+			timers[ i ] = timers[ timers.Length() - 1 ];
+			timers.Remove( timers.Length() - 1 );
+			m_timerCount--;
+			return;
+		}
+	}
+}
+
+void TimerWheel::Advance( EventQueue< ExpireEvent >* expiredOut )
+{
+	m_tick++;
+	ae::Array< Timer >& timers = m_slots[ m_tick % kSlotCount ].timers;
+	uint32_t remaining = 0;
+	for ( Timer& timer : timers )
+	{
+		if ( timer.laps )
+		{
+			timer.laps--;
+			timers[ remaining++ ] = timer;
+		}
+		else
+		{
+			expiredOut->Push( { timer.entity } );
+			m_timerCount--;
+		}
+	}
+	while ( timers.Length() > remaining )
+	{
+		timers.Remove( timers.Length() - 1 );
+	}
+}
+
+void TimerWheel::Clear()
+{
+	for ( Slot& slot : m_slots )
+	{
+		slot.timers.Clear();
+	}
+	m_timerCount = 0;
+}
@@ -0,0 +1,142 @@
+#ifndef ASTEROIDS_EVENTS_H
+#define ASTEROIDS_EVENTS_H
+
+#include "ae/aether.h"
+#include "entt/entt.hpp"
+#include "Jobs.h"
+
+const ae::Tag TAG_EVENTS = "events";
+
+//------------------------------------------------------------------------------
+// Events
+//------------------------------------------------------------------------------
+// An entity with a collision radius touched the level
+struct HitEvent
+{
+	entt::entity entity;
+};
+
+// A timer scheduled with TimerWheel ran out
+struct ExpireEvent
+{
+	entt::entity entity;
+};
+
+// A shooter fired a projectile from the given offset in its local space
+struct FireEvent
+{
+	entt::entity source;
+	ae::Vec3 offset;
+};
+
+// The entity is destroyed at the next command buffer sync point
+struct KillEvent
+{
+	entt::entity entity;
+};
+
+//------------------------------------------------------------------------------
+// EventQueue class
+//------------------------------------------------------------------------------
+// Events raised during a tick. Each job system thread appends to its own lane,
+// so systems running in ParallelFor() can push without locking. Drain() must
+// only be called once every producer has finished.
+template< typename T >
+class EventQueue
+{
+public:
+	void Push( const T& event );
+	// Calls fn for every queued event, lane by lane, then empties the queue
+	template< typename Fn > void Drain( Fn fn );
+	uint32_t Length() const;
+	void Clear();
+
+private:
+	struct Lane
+	{
+		ae::Array< T > events = TAG_EVENTS;
+	};
+	Lane m_lanes[ JobSystem::kMaxThreads ];
+};
+
+//------------------------------------------------------------------------------
+// TimerWheel class
+//------------------------------------------------------------------------------
+// Tick based timers. Each slot holds the timers due on one tick, so advancing
+// only touches the timers that are due (plus the ones that need another lap of
+// the wheel) instead of checking every entity. Not thread safe.
+class TimerWheel
+{
+public:
+	static constexpr uint32_t kSlotCount = 256;
+	
+	// Expires the entity after the given number of calls to Advance(), minimum 1.
+	// Returns the tick the timer expires on, which is needed to cancel it.
+	uint64_t Schedule( entt::entity entity, uint32_t ticks );
+	// Removes the entity's timer, does nothing if it has already expired
+	void Cancel( entt::entity entity, uint64_t expireTick );
+	// Moves to the next tick and pushes an ExpireEvent for each timer that is due
+	void Advance( EventQueue< ExpireEvent >* expiredOut );
+	void Clear();
+	uint64_t GetTick() const { return m_tick; }
+	uint32_t GetTimerCount() const { return m_timerCount; }
+
+private:
+	struct Timer
+	{
+		entt::entity entity;
+		uint32_t laps; // Remaining full turns of the wheel
+	};
+	struct Slot
+	{
+		ae::Array< Timer > timers = TAG_EVENTS;
+	};
+	Slot m_slots[ kSlotCount ];
+	uint64_t m_tick = 0;
+	uint32_t m_timerCount = 0;
+};
+
+//------------------------------------------------------------------------------
+// EventQueue template member functions
+//------------------------------------------------------------------------------
+template< typename T >
+void EventQueue< T >::Push( const T& event )
+{
+	m_lanes[ JobSystem::GetThreadIndex() ].events.Append( event );
+}
+
+template< typename T >
+template< typename Fn >
+void EventQueue< T >::Drain( Fn fn )
+{
+	for ( Lane& lane : m_lanes )
+	{
+		for ( const T& event : lane.events )
+		{
+			fn( event );
+		}
+		lane.events.Clear();
+	}
+}
+
+template< typename T >
+uint32_t EventQueue< T >::Length() const
+{
+	uint32_t length = 0;
+	for ( const Lane& lane : m_lanes )
+	{
+		length += lane.events.Length();
+	}
+	return length;
+}
+
+template< typename T >
+void EventQueue< T >::Clear()
+{
+	for ( Lane& lane : m_lanes )
+	{
+		lane.events.Clear();
+	}
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "FileWatcher.h"
+#include <sys/stat.h>
+#if _AE_LINUX_
+	#include <sys/inotify.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <cstring>
+#endif
+
+//------------------------------------------------------------------------------
+// FileWatcher member functions
+//------------------------------------------------------------------------------
+void FileWatcher::Initialize( const char* directory )
+{
+	m_directory = directory;
+#if _AE_LINUX_
+	m_inotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if ( m_inotify < 0 || inotify_add_watch( m_inotify, directory, IN_CLOSE_WRITE | IN_MOVED_TO ) < 0 )
+	{
+		AE_WARN( "Could not watch '#' for changes", directory );
+	}
+#endif
+}
+
+void FileWatcher::Terminate()
+{
+#if _AE_LINUX_
+	if ( m_inotify >= 0 )
+	{
+		close( m_inotify );
+		m_inotify = -1;
+	}
+#endif
+	m_files.Clear();
+}
+
+void FileWatcher::Watch( const char* path )
+{
+	for ( const WatchedFile& file : m_files )
+	{
+		if ( file.path == path )
+		{
+			return;
+		}
+	}
+	WatchedFile& file = m_files.Append( WatchedFile() );
+	file.path = path;
+	file.modifiedTime = m_GetModifiedTime( path );
+}
+
+void FileWatcher::Poll( ae::Array< ae::Str256 >* changedOut )
+{
+#if _AE_LINUX_
+	if ( m_inotify >= 0 )
+	{
+		alignas(struct inotify_event) char buffer[ 4096 ];
+		ssize_t length;
+		while ( ( length = read( m_inotify, buffer, sizeof(buffer) ) ) > 0 )
+		{
+			for ( ssize_t offset = 0; offset < length; )
+			{
+				const struct inotify_event* event = (const struct inotify_event*)( buffer + offset );
+				offset += sizeof(struct inotify_event) + event->len;
+				if ( !event->len )
+				{
+					continue;
+				}
+				for ( const WatchedFile& file : m_files )
+				{
+					if ( file.path == event->name && changedOut->Find( file.path ) < 0 )
+					{
+						changedOut->Append( file.path );
+					}
+				}
+			}
+		}
+		return;
+	}
+#endif
+	for ( WatchedFile& file : m_files )
+	{
+		int64_t modifiedTime = m_GetModifiedTime( file.path.c_str() );
+		if ( modifiedTime != file.modifiedTime )
+		{
+			file.modifiedTime = modifiedTime;
+			changedOut->Append( file.path );
+		}
+	}
+}
+
+int64_t FileWatcher::m_GetModifiedTime( const char* path ) const
+{
+	ae::Str256 fullPath = m_directory;
+	ae::FileSystem::AppendToPath( &fullPath, path );
+	struct stat info;
+	if ( stat( fullPath.c_str(), &info ) != 0 )
+	{
+		return 0;
+	}
+	return (int64_t)info.st_mtime;
+}
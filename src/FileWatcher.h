@@ -0,0 +1,35 @@
+#ifndef ASTEROIDS_FILEWATCHER_H
+#define ASTEROIDS_FILEWATCHER_H
+
+#include "ae/aether.h"
+
+const ae::Tag TAG_FILEWATCHER = "filewatcher";
+
+//------------------------------------------------------------------------------
+// FileWatcher class
+//------------------------------------------------------------------------------
+// Reports files in a directory that have been written to. Uses inotify on
+// Linux, other platforms poll the modification time of each watched file.
+class FileWatcher
+{
+public:
+	void Initialize( const char* directory );
+	void Terminate();
+	// Paths are relative to the watched directory
+	void Watch( const char* path );
+	// Appends the watched paths that changed since the last call
+	void Poll( ae::Array< ae::Str256 >* changedOut );
+
+private:
+	struct WatchedFile
+	{
+		ae::Str256 path;
+		int64_t modifiedTime = 0;
+	};
+	int64_t m_GetModifiedTime( const char* path ) const;
+	ae::Str256 m_directory;
+	ae::Array< WatchedFile > m_files = TAG_FILEWATCHER;
+	int m_inotify = -1;
+};
+
+#endif
@@ -1,5 +1,21 @@
 #include "Game.h"
 #include "Components.h"
+#include "Memory.h"
+#include "Scenario.h"
+#include <algorithm>
+#include <chrono>
+
+// Cell size of the grid used to find sleeping bodies near collisions
+const float kSleepCellSize = 4.0f;
+// Keeps update dts non-zero, since zero means the update is skipped
+const float kMinUpdateDt = 0.000001f;
+// CPU and GPU memory for meshes, unreferenced meshes are evicted above this
+const uint64_t kMeshBudget = 32 * 1024 * 1024;
+// Low latency frame pacing. Input is sampled at the deadline minus the smoothed
+// frame cost, minus a few mean deviations and a fixed margin for sleep overshoot.
+const double kFrameCostSmoothing = 0.1;
+const double kFrameCostDeviations = 2.0;
+const double kPacingMargin = 0.001;
 
 ae::DebugLines*& GetDebugLines()
 {
@@ -12,7 +28,10 @@ void Game::Initialize()
 	window.Initialize( 800, 600, false, true );
 	window.SetTitle( "AE-Asteroids" );
 	render.Initialize( &window );
-	debugLines.Initialize( 256 );
+	for ( RenderState& state : m_renderStates )
+	{
+		state.debugLines.Initialize( 256 );
+	}
 	input.Initialize( &window );
 #if _AE_WINDOWS_
 	const char* dataDir = "../data";
@@ -23,254 +42,1111 @@ void Game::Initialize()
 #endif
 	file.Initialize( dataDir, "johnhues", "AE-Asteroids" );
 	timeStep.SetTimeStep( 1.0f / 60.0f );
-	GetDebugLines() = &debugLines;
+	jobs.Initialize();
+	m_simThread = std::thread( [ this ]() { m_SimulationMain(); } );
+	m_reloadThread = std::thread( [ this ]() { m_ReloadMain(); } );
+	registry.on_construct< Projectile >().connect< &Game::m_OnProjectileCreated >( this );
+	registry.on_destroy< Projectile >().connect< &Game::m_OnProjectileDestroyed >( this );
+	
+	GameAllocator& allocator = GetGameAllocator();
+	allocator.SetBudget( TAG_GAME, 4 * 1024 * 1024 );
+	allocator.SetBudget( TAG_LEVEL, 1024 * 1024 );
+	allocator.SetBudget( TAG_RESOURCE, 8 * 1024 * 1024 );
 	
-	shader.Initialize( kVertShader, kFragShader, nullptr, 0 );
-	shader.SetDepthTest( true );
-	shader.SetDepthWrite( true );
+	ae::Str256 dataRoot;
+	file.GetRootDir( ae::FileSystem::Root::Data, &dataRoot );
+	m_fileWatcher.Initialize( dataRoot.c_str() );
 	
-	level0.Initialize( &file, "level0.fbx" );
-	cubeModel.Initialize( &file, "cube.fbx" );
-	shipModel.Initialize( &file, "ship.fbx" );
-	asteroidModel.Initialize( kAsteroidVerts, kAsteroidIndices, countof(kAsteroidVerts), countof(kAsteroidIndices) );
+	resources.Initialize( &file, kMeshBudget );
+	shader = resources.LoadShader( "default", kVertShader, kFragShader );
+	shaderLayout.Initialize( kVertShader, kFragShader );
+	shipMesh = resources.LoadMesh( "ship.fbx" );
+	m_fileWatcher.Watch( "ship.fbx" );
+	asteroidMesh = resources.CreateMesh( "asteroid", kAsteroidVerts, kAsteroidIndices, countof(kAsteroidVerts), countof(kAsteroidIndices) );
 }
 
 void Game::Terminate()
 {
 	AE_INFO( "Terminate" );
+	GetGameAllocator().LogStats();
+	AE_INFO( "Uniform bytes last frame: #", shaderLayout.GetFrameUploadBytes() );
+	AE_INFO( "Triangles last frame: # (# without LODs)", triangleCount, fullTriangleCount );
+	AE_INFO( "Physics bodies: # active # sleeping", GetActiveBodyCount(), GetSleepingBodyCount() );
+	AE_INFO( "Simulation LOD: # full # medium # far", m_simLodCounts[ SimLod::Full ], m_simLodCounts[ SimLod::Medium ], m_simLodCounts[ SimLod::Far ] );
+	resources.LogStats();
+	m_LogLatency();
 	//input.Terminate();
-	debugLines.Terminate();
+	{
+		std::lock_guard< std::mutex > lock( m_reloadLock );
+		m_reloadQuit = true;
+	}
+	m_reloadWake.notify_one();
+	m_reloadThread.join();
+	for ( PendingReload* reload : m_pendingReloads )
+	{
+		ae::Delete( reload );
+	}
+	m_pendingReloads.Clear();
+	m_reloadQueue.Clear();
+	m_fileWatcher.Terminate();
+	telemetry.Close();
+	{
+		std::lock_guard< std::mutex > lock( m_simLock );
+		m_simQuit = true;
+	}
+	m_simWake.notify_one();
+	m_simThread.join();
+	jobs.Terminate();
+	for ( MeshHandle mesh : m_sceneMeshes )
+	{
+		resources.Release( mesh );
+	}
+	m_sceneMeshes.Clear();
+	resources.Release( shipMesh );
+	resources.Release( asteroidMesh );
+	resources.Release( shader );
+	resources.Terminate();
+	for ( RenderState& state : m_renderStates )
+	{
+		state.debugLines.Terminate();
+	}
 	render.Terminate();
 	window.Terminate();
 }
 
 void Game::Load()
 {
-	// Level
+	m_BeginLoad();
+	
+	Level& level = GetOrCreateLevel();
+	level.AddMesh( &resources, LoadMesh( "level0.fbx" ), ae::Matrix4::Identity() );
+	level.AddMesh( &resources, LoadMesh( "cube.fbx" ), ae::Matrix4::Translation( ae::Vec3( 3.0f, 3.0f, 0.0f ) ) * ae::Matrix4::Scaling( ae::Vec3( 3.0f ) ) );
+	
+	SpawnShips( 1, ae::Vec2( 0.0f ), 0.0f, true );
+	SpawnCamera();
+	SpawnTurrets( 1, ae::Vec2( -4.0f, 4.0f ), 0.0f );
+}
+
+bool Game::LoadScenario( const char* path )
+{
+	Scenario scenario;
+	if ( !scenario.Load( &file, path ) )
 	{
-		entt::entity entity = registry.create();
-		
-		Level& level = registry.emplace< Level >( entity );
-		level.Clear();
-		level.AddMesh( &level0, ae::Matrix4::Identity() );
-		level.AddMesh( &cubeModel, ae::Matrix4::Translation( ae::Vec3( 3.0f, 3.0f, 0.0f ) ) * ae::Matrix4::Scaling( ae::Vec3( 3.0f ) ) );
+		return false;
 	}
+	m_BeginLoad();
+	double startTime = ae::GetTime();
+	scenario.Spawn( this );
+	AE_INFO( "Loaded scenario '#' with # entities in #ms", path, (uint32_t)registry.view< Transform >().size(), (uint32_t)( ( ae::GetTime() - startTime ) * 1000.0 ) );
+	return true;
+}
+
+MeshHandle Game::LoadMesh( const char* path )
+{
+	// Built-in meshes such as "asteroid" are always loaded, so only new files are watched
+	const bool loaded = resources.FindMesh( path ).IsValid();
+	MeshHandle mesh = resources.LoadMesh( path );
+	if ( mesh.IsValid() )
+	{
+		m_sceneMeshes.Append( mesh );
+		if ( !loaded )
+		{
+			m_fileWatcher.Watch( path );
+		}
+	}
+	return mesh;
+}
+
+Level& Game::GetOrCreateLevel()
+{
+	if ( Level* existing = registry.try_get< Level >( this->level ) )
+	{
+		return *existing;
+	}
+	entt::entity entity = registry.create();
+	this->level = entity;
+	return registry.emplace< Level >( entity );
+}
+
+void Game::SpawnCamera()
+{
+	entt::entity entity = registry.create();
+	Transform& transform = registry.emplace< Transform >( entity );
+	transform.SetPosition( ae::Vec3( 0, 0, 20.0f ) );
+	registry.emplace< Camera >( entity );
+}
+
+void Game::SpawnShips( uint32_t count, ae::Vec2 center, float radius, bool local, TeamId teamId )
+{
+	AE_ASSERT_MSG( !local || count == 1, "Only one ship can be local, got #", count );
+	const ae::Array< entt::entity >& entities = m_CreateEntities( count, center, radius );
+	entt::entity* begin = m_spawnEntities.begin();
+	entt::entity* end = m_spawnEntities.end();
+	
+	registry.insert< Collision >( begin, end );
 	
-	// Ship
+	Physics physics;
+	physics.moveDrag = 0.7f;
+	physics.rotationDrag = 1.7f;
+	physics.collisionRadius = 0.7f;
+	registry.insert< Physics >( begin, end, physics );
+	
+	Ship ship;
+	ship.local = local;
+	ship.speed = 10.0f;
+	ship.rotationSpeed = 5.0f;
+	registry.insert< Ship >( begin, end, ship );
+	
+	Team team;
+	team.teamId = local ? TeamId::Player : teamId;
+	registry.insert< Team >( begin, end, team );
+	
+	registry.insert< Shooter >( begin, end );
+	registry.insert< SimLod >( begin, end );
+	if ( !local )
 	{
-		entt::entity entity = registry.create();
-		
-		registry.emplace< Transform >( entity );
-		registry.emplace< Collision >( entity );
-		
-		Physics& physics = registry.emplace< Physics >( entity );
-		physics.moveDrag = 0.7f;
-		physics.rotationDrag = 1.7f;
-		physics.collisionRadius = 0.7f;
-		
-		Ship& ship = registry.emplace< Ship >( entity );
-		ship.local = true;
-		ship.speed = 10.0f;
-		ship.rotationSpeed = 5.0f;
-		
-		Team& team = registry.emplace< Team >( entity );
-		team.teamId = TeamId::Player;
-		
-		registry.emplace< Shooter >( entity );
-		
-		Model& model = registry.emplace< Model >( entity );
-		model.mesh = &shipModel;
-		model.shader = &shader;
-		model.color = ae::Color::PicoBlue();
-		
-		localShip = entity;
-	}
-	
-	// Camera
-	{
-		entt::entity entity = registry.create();
-		Transform& transform = registry.emplace< Transform >( entity );
-		transform.SetPosition( ae::Vec3( 0, 0, 20.0f ) );
-		registry.emplace< Camera >( entity );
-	}
-
-//	// Asteroids
-//	for ( uint32_t i = 0; i < 8; i++ )
-//	{
-//		entt::entity entity = registry.create();
-//
-//		Transform& transform = registry.emplace< Transform >( entity );
-//		transform.SetPosition( ae::Vec3( ae::Random( -1.0f, 1.0f ), ae::Random( -1.0f, 1.0f ), 0.0f ) );
-//
-//		registry.emplace< Collision >( entity );
-//
-//		float angle = ae::Random( 0.0f, ae::TWO_PI );
-//		float speed = ae::Random( 0.1f, 0.7f );
-//		Physics& physics = registry.emplace< Physics >( entity );
-//		physics.vel = ae::Vec3( cosf( angle ), sinf( angle ), 0.0f ) * speed;
-//
-//		registry.emplace< Asteroid >( entity );
-//
-//		Model& model = registry.emplace< Model >( entity );
-//		model.mesh = &asteroidModel;
-//		model.shader = &shader;
-//	}
-	
-	// Turret
-	{
-		entt::entity entity = registry.create();
-		
-		Transform& transform = registry.emplace< Transform >( entity );
-		transform.SetPosition( ae::Vec3( -4.0f, 4.0f, 0.0f ) );
-		
-		registry.emplace< Collision >( entity );
-		
-		Physics& physics = registry.emplace< Physics >( entity );
-		physics.rotationDrag = 1.7f;
-		
-		registry.emplace< Turret >( entity );
-		
-		Team& team = registry.emplace< Team >( entity );
-		team.teamId = TeamId::Enemy;
-		
-		Shooter& shooter = registry.emplace< Shooter >( entity );
-		shooter.fireInterval = 0.4f;
-		
-		Model& model = registry.emplace< Model >( entity );
-		model.mesh = &shipModel;
-		model.shader = &shader;
-		model.color = ae::Color::PicoDarkPurple();
+		registry.insert< AiShip >( begin, end );
+	}
+	
+	Model model;
+	model.mesh = shipMesh;
+	model.shader = shader;
+	model.color = local ? ae::Color::PicoBlue() : ae::Color::PicoRed();
+	registry.insert< Model >( begin, end, model );
+	
+	if ( local && entities.Length() )
+	{
+		localShip = entities[ 0 ];
+	}
+}
+
+void Game::SpawnTurrets( uint32_t count, ae::Vec2 center, float radius )
+{
+	m_CreateEntities( count, center, radius );
+	entt::entity* begin = m_spawnEntities.begin();
+	entt::entity* end = m_spawnEntities.end();
+	
+	registry.insert< Collision >( begin, end );
+	
+	Physics physics;
+	physics.rotationDrag = 1.7f;
+	registry.insert< Physics >( begin, end, physics );
+	
+	registry.insert< Turret >( begin, end );
+	
+	Team team;
+	team.teamId = TeamId::Enemy;
+	registry.insert< Team >( begin, end, team );
+	
+	Shooter shooter;
+	shooter.fireInterval = 0.4f;
+	registry.insert< Shooter >( begin, end, shooter );
+	registry.insert< SimLod >( begin, end );
+	
+	Model model;
+	model.mesh = shipMesh;
+	model.shader = shader;
+	model.color = ae::Color::PicoDarkPurple();
+	registry.insert< Model >( begin, end, model );
+}
+
+void Game::SpawnAsteroids( uint32_t count, ae::Vec2 center, float radius )
+{
+	m_CreateEntities( count, center, radius );
+	entt::entity* begin = m_spawnEntities.begin();
+	entt::entity* end = m_spawnEntities.end();
+	
+	registry.insert< Collision >( begin, end );
+	registry.insert< Physics >( begin, end );
+	registry.insert< Asteroid >( begin, end );
+	registry.insert< SimLod >( begin, end );
+	
+	Model model;
+	model.mesh = asteroidMesh;
+	model.shader = shader;
+	registry.insert< Model >( begin, end, model );
+	
+	// Asteroids wrap within the spawn areas, which are at least the size of the
+	// original single screen play area
+	const float extent = ae::Max( radius, 1.0f );
+	m_asteroidFieldMin.x = ae::Min( m_asteroidFieldMin.x, center.x - extent );
+	m_asteroidFieldMin.y = ae::Min( m_asteroidFieldMin.y, center.y - extent );
+	m_asteroidFieldMax.x = ae::Max( m_asteroidFieldMax.x, center.x + extent );
+	m_asteroidFieldMax.y = ae::Max( m_asteroidFieldMax.y, center.y + extent );
+	for ( entt::entity entity : m_spawnEntities )
+	{
+		float angle = ae::Random( 0.0f, ae::TWO_PI );
+		float speed = ae::Random( 0.1f, 0.7f );
+		registry.get< Physics >( entity ).vel = ae::Vec3( cosf( angle ), sinf( angle ), 0.0f ) * speed;
+	}
+}
+
+void Game::m_BeginLoad()
+{
+	// Meshes of the previous scene stay cached until the budget needs the space
+	if ( Level* level = registry.try_get< Level >( this->level ) )
+	{
+		level->Clear();
+	}
+	for ( MeshHandle mesh : m_sceneMeshes )
+	{
+		resources.Release( mesh );
+	}
+	m_sceneMeshes.Clear();
+	m_asteroidFieldMin = ae::Vec2( ae::MaxValue< float >() );
+	m_asteroidFieldMax = ae::Vec2( -ae::MaxValue< float >() );
+	// Projectiles don't outlive the scene they were fired in, and no timers are
+	// carried over into the new one
+	auto projectiles = registry.view< Projectile >();
+	registry.destroy( projectiles.begin(), projectiles.end() );
+	timers.Clear();
+	
+	// Create groups up front so components are packed as they are emplaced
+	GetPhysicsGroup( registry );
+	GetDrawGroup( registry );
+}
+
+const ae::Array< entt::entity >& Game::m_CreateEntities( uint32_t count, ae::Vec2 center, float radius )
+{
+	// Entities and their transforms are created in bulk, positions are spread
+	// uniformly over a disc around the center
+	m_spawnEntities.Clear();
+	m_spawnEntities.Reserve( count );
+	for ( uint32_t i = 0; i < count; i++ )
+	{
+		m_spawnEntities.Append( entt::null );
 	}
+	registry.create( m_spawnEntities.begin(), m_spawnEntities.end() );
+	registry.insert< Transform >( m_spawnEntities.begin(), m_spawnEntities.end() );
+	for ( entt::entity entity : m_spawnEntities )
+	{
+		float r = radius * sqrtf( ae::Random( 0.0f, 1.0f ) );
+		float angle = ae::Random( 0.0f, ae::TWO_PI );
+		registry.get< Transform >( entity ).SetPosition( ae::Vec3( center.x + cosf( angle ) * r, center.y + sinf( angle ) * r, 0.0f ) );
+	}
+	return m_spawnEntities;
 }
 
 void Game::Run()
 {
 	AE_INFO( "Run" );
+	// Low latency mode doesn't sleep until the frame cost has been measured
+	m_frameCost = timeStep.GetTimeStep();
 	while ( !input.quit )
 	//while ( !input.GetState()->exit )
 	{
+		if ( lowLatency )
+		{
+			// timeStep.Wait() returned at the start of this frame's time step
+			m_WaitForLateInput( ae::GetTime() + timeStep.GetTimeStep() );
+		}
+		const double frameStart = ae::GetTime();
+		// Input is only pumped here, never while the simulation is running
 		input.Pump();
+		m_inputTime = ae::GetTime();
+		if ( input.Get( ae::Key::F2 ) && !input.GetPrev( ae::Key::F2 ) )
+		{
+			GetGameAllocator().LogStats();
+			AE_INFO( "Triangles last frame: # (# without LODs)", triangleCount, fullTriangleCount );
+			AE_INFO( "Physics bodies: # active # sleeping", GetActiveBodyCount(), GetSleepingBodyCount() );
+			AE_INFO( "Simulation LOD: # full # medium # far", m_simLodCounts[ SimLod::Full ], m_simLodCounts[ SimLod::Medium ], m_simLodCounts[ SimLod::Far ] );
+			resources.LogStats();
+			m_LogLatency();
+		}
+		if ( input.Get( ae::Key::F3 ) && !input.GetPrev( ae::Key::F3 ) )
+		{
+			pipelined = !pipelined;
+			AE_INFO( "Pipelined frames #", pipelined ? "on" : "off" );
+		}
+		if ( input.Get( ae::Key::F4 ) && !input.GetPrev( ae::Key::F4 ) )
+		{
+			m_LogLatency();
+			lowLatency = !lowLatency;
+			AE_INFO( "Low latency mode #", lowLatency ? "on" : "off" );
+			// Latency stats restart so they only cover the new mode
+			m_frameCost = timeStep.GetTimeStep();
+			m_frameCostDeviation = 0.0;
+			m_latencySum = 0.0;
+			m_latencyMax = 0.0;
+			m_latencyCount = 0;
+		}
+		m_UpdateHotReload();
+		
+		aspectRatio = render.GetAspectRatio();
+		RenderState* simState = &m_renderStates[ m_simStateIndex ];
+		if ( pipelined && !lowLatency )
+		{
+			// Draws lag the simulation by one tick
+			m_StartSimulation( simState );
+			m_Render( &m_renderStates[ 1 - m_simStateIndex ] );
+			m_FinishSimulation();
+		}
+		else
+		{
+			m_Simulate( simState );
+			m_Render( simState );
+		}
+		m_simStateIndex = 1 - m_simStateIndex;
+		resources.EndFrame();
 		
-		// Update
+		// Counters cover the tick that was just simulated and the state that was
+		// just drawn, which lags by one tick when pipelined
+		telemetry.Add( TelemetryCounter::FrameUs, (uint64_t)( ( ae::GetTime() - frameStart ) * 1000000.0 ) );
+		if ( telemetry.IsOpen() )
+		{
+			telemetry.Set( TelemetryCounter::Entities, registry.view< Transform >().size() );
+			telemetry.Set( TelemetryCounter::PhysicsBodies, registry.view< Physics >().size() );
+			telemetry.Set( TelemetryCounter::SleepingBodies, GetSleepingBodyCount() );
+			telemetry.Set( TelemetryCounter::Models, registry.view< Model >().size() );
+			telemetry.Set( TelemetryCounter::Ships, registry.view< Ship >().size() );
+			telemetry.Set( TelemetryCounter::Turrets, registry.view< Turret >().size() );
+			telemetry.Set( TelemetryCounter::AiShips, registry.view< AiShip >().size() );
+			telemetry.Set( TelemetryCounter::Asteroids, registry.view< Asteroid >().size() );
+			telemetry.Set( TelemetryCounter::Projectiles, registry.view< Projectile >().size() );
+			telemetry.Set( TelemetryCounter::SimLodFull, m_simLodCounts[ SimLod::Full ] );
+			telemetry.Set( TelemetryCounter::SimLodMedium, m_simLodCounts[ SimLod::Medium ] );
+			telemetry.Set( TelemetryCounter::SimLodFar, m_simLodCounts[ SimLod::Far ] );
+		}
+		// Both stages are finished, so the older frame arena can be reused
+		GetGameAllocator().EndFrame();
+		telemetry.Set( TelemetryCounter::HeapAllocations, GetGameAllocator().GetLastFrameHeapAllocations() );
+		telemetry.EndFrame();
+		
+		if ( lowLatency )
+		{
+			m_UpdateFrameCost( ae::GetTime() - m_inputTime );
+		}
+		timeStep.Wait();
+	}
+}
+
+void Game::m_Simulate( RenderState* stateOut )
+{
+	Telemetry::Scope simulateScope( &telemetry, TelemetryCounter::SimulateUs );
+	stateOut->debugLines.Clear();
+	GetDebugLines() = &stateOut->debugLines;
+	m_simTime += timeStep.GetDt();
+	m_UpdateSimLod();
+	
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::ShipUs );
 		for( auto [ entity, ship, transform, physics ] : registry.view< Ship, Transform, Physics >().each() )
 		{
 			ship.Update( this, entity, transform, physics );
 		}
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::LineOfSightUs );
+		m_UpdateLineOfSight();
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::TurretUs );
 		for( auto [ entity, turret ] : registry.view< Turret >().each() )
 		{
-			turret.Update( this, entity );
+			if ( float dt = GetUpdateDt( entity ) )
+			{
+				turret.Update( this, entity, dt );
+			}
 		}
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::AiUs );
+		m_aiController.Update( this );
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::AsteroidUs );
 		for( auto [ entity, asteroid, transform, physics ] : registry.view< Asteroid, Transform, Physics >().each() )
 		{
-			asteroid.Update( this, transform, physics );
+			if ( GetUpdateDt( entity ) )
+			{
+				asteroid.Update( this, entity, transform, physics );
+			}
 		}
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::ShooterUs );
 		for( auto [ entity, shooter ] : registry.view< Shooter >().each() )
 		{
-			shooter.Update( this, entity );
-		}
-		for( auto [ entity, projectile ] : registry.view< Projectile >().each() )
-		{
-			projectile.Update( this, entity );
+			if ( GetUpdateDt( entity ) )
+			{
+				shooter.Update( this, entity );
+			}
 		}
-		for( auto [ entity, physics, transform ]: registry.view< Physics, Transform >().each() )
+	}
+	auto physicsGroup = GetPhysicsGroup( registry );
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::PhysicsUs );
+		m_ApplyWakes();
+		const uint32_t kSleepTicks = 30;
+		for( auto [ entity, physics, transform ]: physicsGroup.each() )
 		{
-			physics.Update( this, transform );
+			// Distant bodies integrate less often with a larger step
+			const float dt = GetUpdateDt( entity );
+			if ( !dt )
+			{
+				continue;
+			}
+			physics.Update( this, transform, dt );
+			if ( !physics.IsResting() )
+			{
+				physics.restingTicks = 0;
+			}
+			else if ( ++physics.restingTicks >= kSleepTicks )
+			{
+				m_sleepEntities.Append( entity );
+			}
 		}
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::CollisionUs );
+		uint32_t tests = 0;
+		uint32_t hits = 0;
 		for( auto [ entity, level ]: registry.view< Level >().each() )
 		{
-			for( auto [ entity, physics, transform ]: registry.view< Physics, Transform >().each() )
+			for( auto [ entity, physics, transform ]: physicsGroup.each() )
 			{
-				if ( physics.collisionRadius )
+				// Bodies that didn't move this tick were already tested at their current position
+				if ( physics.collisionRadius && GetUpdateDt( entity ) )
 				{
-					physics.hit = level.Test( &transform, &physics );
+					tests++;
+					if ( level.Test( &transform, &physics ) )
+					{
+						hitEvents.Push( { entity } );
+						hits++;
+					}
 				}
 			}
 		}
+		telemetry.Add( TelemetryCounter::CollisionTests, tests );
+		telemetry.Add( TelemetryCounter::CollisionHits, hits );
+		// After collision so bodies put to sleep this tick still had their final test
+		m_ApplySleeps();
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::CameraUs );
 		for( auto [ entity, camera, transform ] : registry.view< Camera, Transform >().each() )
 		{
 			camera.Update( this, transform );
 		}
-		
-		uint32_t pendingKillCount = m_pendingKill.Length();
-		for ( uint32_t i = 0; i < pendingKillCount; i++ )
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::EventsUs );
+		timers.Advance( &expireEvents );
+		m_ProcessEvents();
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::CommandsUs );
+		ApplyCommands();
+	}
+	{
+		Telemetry::Scope scope( &telemetry, TelemetryCounter::ExtractUs );
+		m_Extract( stateOut );
+	}
+	GetDebugLines() = nullptr;
+}
+
+void Game::m_Extract( RenderState* stateOut )
+{
+	// The camera matrix is copied so it always matches the transforms it is drawn with
+	stateOut->frame.worldToNdc = worldToNdc;
+	stateOut->frame.ambientLight = ambientLight.GetLinearRGB();
+	stateOut->inputTime = m_inputTime;
+	stateOut->draws.Clear();
+	
+	// Models are kept sorted by shader and mesh so consecutive draws share
+	// state. Insertion sort is close to linear since only new spawns move.
+	auto drawGroup = GetDrawGroup( registry );
+	drawGroup.sort< Model >( []( const Model& lhs, const Model& rhs )
+	{
+		if ( lhs.shader != rhs.shader )
 		{
-			registry.destroy( m_pendingKill.GetKey( i ) );
+			return lhs.shader < rhs.shader;
 		}
-		m_pendingKill.Clear();
-		
-		// Render
-		render.Activate();
-		render.Clear( ae::Color::PicoBlack() );
+		return lhs.mesh < rhs.mesh;
+	}, entt::insertion_sort{} );
+	stateOut->draws.Reserve( (uint32_t)drawGroup.size() );
+	for( auto [ entity, model, transform ]: drawGroup.each() )
+	{
+		model.Extract( &resources, transform, stateOut );
+	}
+	
+	if ( Level* level = registry.try_get< Level >( this->level ) )
+	{
+		level->Extract( this, stateOut );
+	}
+}
+
+void Game::m_Render( RenderState* state )
+{
+	Telemetry::Scope scope( &telemetry, TelemetryCounter::RenderUs );
+	render.Activate();
+	render.Clear( ae::Color::PicoBlack() );
+	
+	shaderLayout.BeginFrame( state->frame );
+	triangleCount = 0;
+	fullTriangleCount = 0;
+	for ( const RenderState::Draw& draw : state->draws )
+	{
+		// A hot reload may have changed the LOD count since the state was extracted
+		const MeshResource* mesh = draw.mesh;
+		const uint32_t lod = ae::Min( draw.lod, ae::Max( mesh->GetLodCount(), 1u ) - 1 );
+		triangleCount += mesh->GetTriangleCount( lod );
+		fullTriangleCount += mesh->GetTriangleCount( 0 );
 		
-		auto drawView = registry.view< const Transform, const Model >();
-		for( auto [ entity, transform, model ]: drawView.each() )
+		ObjectUniforms object;
+		object.modelToNdc = state->frame.worldToNdc * draw.transform;
+		object.normalMatrix = draw.transform.GetNormalMatrix();
+		object.color = draw.color;
+		mesh->GetVertexData( lod ).Render( draw.shader, shaderLayout.Set( object ) );
+	}
+	telemetry.Add( TelemetryCounter::DrawCalls, state->draws.Length() );
+	telemetry.Add( TelemetryCounter::Triangles, triangleCount );
+	
+	//state->debugLines.Render( state->frame.worldToNdc );
+	
+	render.Present();
+	
+	// Measured to the drawn state's input, so pipelining adds a tick of latency
+	const double latency = ae::GetTime() - state->inputTime;
+	m_latencySum += latency;
+	m_latencyMax = ae::Max( m_latencyMax, latency );
+	m_latencyCount++;
+	telemetry.Add( TelemetryCounter::InputLatencyUs, (uint64_t)( latency * 1000000.0 ) );
+}
+
+void Game::m_WaitForLateInput( double deadline )
+{
+	const double margin = kFrameCostDeviations * m_frameCostDeviation + kPacingMargin;
+	const double sleep = deadline - m_frameCost - margin - ae::GetTime();
+	if ( sleep > 0.0 )
+	{
+		// A frame that costs more than the time step never sleeps, so throughput
+		// is the same as without low latency mode
+		std::this_thread::sleep_for( std::chrono::duration< double >( sleep ) );
+		telemetry.Add( TelemetryCounter::PacingSleepUs, (uint64_t)( sleep * 1000000.0 ) );
+	}
+}
+
+void Game::m_UpdateFrameCost( double cost )
+{
+	// Smoothed mean and mean deviation, like a network round trip estimate, so
+	// noisy frames widen the margin instead of missing the deadline
+	m_frameCostDeviation += kFrameCostSmoothing * ( fabs( cost - m_frameCost ) - m_frameCostDeviation );
+	m_frameCost += kFrameCostSmoothing * ( cost - m_frameCost );
+}
+
+void Game::m_LogLatency() const
+{
+	if ( m_latencyCount )
+	{
+		AE_INFO( "Input latency: #ms average #ms max over # frames (low latency mode #, frame cost #ms)",
+			(float)( m_latencySum / m_latencyCount * 1000.0 ),
+			(float)( m_latencyMax * 1000.0 ),
+			m_latencyCount,
+			lowLatency ? "on" : "off",
+			(float)( m_frameCost * 1000.0 )
+		);
+	}
+}
+
+void Game::m_StartSimulation( RenderState* stateOut )
+{
+	{
+		std::lock_guard< std::mutex > lock( m_simLock );
+		AE_ASSERT( !m_simState );
+		m_simState = stateOut;
+	}
+	m_simWake.notify_one();
+}
+
+void Game::m_FinishSimulation()
+{
+	std::unique_lock< std::mutex > lock( m_simLock );
+	m_simDone.wait( lock, [ this ]() { return !m_simState; } );
+}
+
+void Game::m_SimulationMain()
+{
+	std::unique_lock< std::mutex > lock( m_simLock );
+	while ( true )
+	{
+		m_simWake.wait( lock, [ this ]() { return m_simState || m_simQuit; } );
+		if ( m_simQuit )
 		{
-			model.Draw( this, transform );
+			return;
 		}
-		
-		if ( Level* level = registry.try_get< Level >( this->level ) )
+		RenderState* state = m_simState;
+		lock.unlock();
+		m_Simulate( state );
+		lock.lock();
+		m_simState = nullptr;
+		m_simDone.notify_one();
+	}
+}
+
+bool Game::WrapToAsteroidField( ae::Vec3* pos ) const
+{
+	if ( m_asteroidFieldMin.x > m_asteroidFieldMax.x )
+	{
+		return false;
+	}
+	// Asteroids move much less than the size of the field in one tick
+	const ae::Vec2 size = m_asteroidFieldMax - m_asteroidFieldMin;
+	bool wrapped = true;
+	if ( pos->x < m_asteroidFieldMin.x )
+	{
+		pos->x += size.x;
+	}
+	else if ( pos->x > m_asteroidFieldMax.x )
+	{
+		pos->x -= size.x;
+	}
+	else if ( pos->y < m_asteroidFieldMin.y )
+	{
+		pos->y += size.y;
+	}
+	else if ( pos->y > m_asteroidFieldMax.y )
+	{
+		pos->y -= size.y;
+	}
+	else
+	{
+		wrapped = false;
+	}
+	return wrapped;
+}
+
+void Game::m_UpdateLineOfSight()
+{
+	// Gather every turret and AI ship targeting ray so the level is queried in one
+	// batch. The rays only live for this tick, so they come from the frame arena
+	// and are reserved up front to avoid growing inside it.
+	const uint32_t maxRayCount = (uint32_t)( registry.view< Turret >().size() + registry.view< AiShip >().size() );
+	ae::Array< entt::entity > losEntities = TAG_FRAME;
+	ae::Array< Level::Ray > losRays = TAG_FRAME;
+	ae::Array< Level::RayHit > losHits = TAG_FRAME;
+	losEntities.Reserve( maxRayCount );
+	losRays.Reserve( maxRayCount );
+	losHits.Reserve( maxRayCount );
+	for( auto [ entity, turret, transform ] : registry.view< Turret, Transform >().each() )
+	{
+		if ( !GetUpdateDt( entity ) )
 		{
-			level->Render( this );
+			// Keeps its visibility until the turret is next updated
+			continue;
 		}
-		
-		//debugLines.Render( worldToNdc );
-		debugLines.Clear();
+		const Transform* targetTransform = registry.valid( turret.target ) ? registry.try_get< Transform >( turret.target ) : nullptr;
+		turret.targetVisible = false;
+		if ( targetTransform )
+		{
+			losEntities.Append( entity );
+			losRays.Append( { transform.GetPosition(), targetTransform->GetPosition() } );
+		}
+	}
+	const uint32_t turretRayCount = losRays.Length();
+	for( auto [ entity, ai, transform ] : registry.view< AiShip, Transform >().each() )
+	{
+		if ( !GetUpdateDt( entity ) )
+		{
+			continue;
+		}
+		const Transform* targetTransform = registry.valid( ai.target ) ? registry.try_get< Transform >( ai.target ) : nullptr;
+		ai.targetVisible = false;
+		if ( targetTransform )
+		{
+			losEntities.Append( entity );
+			losRays.Append( { transform.GetPosition(), targetTransform->GetPosition() } );
+		}
+	}
+	
+	const Level* level = registry.try_get< Level >( this->level );
+	const uint32_t rayCount = losRays.Length();
+	for ( uint32_t i = 0; i < rayCount; i++ )
+	{
+		losHits.Append( Level::RayHit() );
+	}
+	if ( level )
+	{
+		level->Raycast( losRays.begin(), losHits.begin(), rayCount, &jobs );
+	}
+	for ( uint32_t i = 0; i < turretRayCount; i++ )
+	{
+		registry.get< Turret >( losEntities[ i ] ).targetVisible = !losHits[ i ].hit;
+	}
+	for ( uint32_t i = turretRayCount; i < rayCount; i++ )
+	{
+		registry.get< AiShip >( losEntities[ i ] ).targetVisible = !losHits[ i ].hit;
+	}
+}
 
-		render.Present();
-		timeStep.Wait();
+void Game::m_UpdateHotReload()
+{
+	m_changedFiles.Clear();
+	m_fileWatcher.Poll( &m_changedFiles );
+	for ( const ae::Str256& path : m_changedFiles )
+	{
+		// Evicted meshes are loaded from the new file when next requested
+		MeshHandle mesh = resources.FindMesh( path.c_str() );
+		if ( mesh.IsValid() )
+		{
+			m_StartReload( mesh );
+		}
+	}
+	
+	// Handles refer to the resource slot, so swapping the new data in place
+	// updates every model and level mesh at once
+	for ( uint32_t i = 0; i < m_pendingReloads.Length(); )
+	{
+		PendingReload* reload = m_pendingReloads[ i ];
+		if ( !reload->done )
+		{
+			i++;
+			continue;
+		}
+		m_pendingReloads.Remove( i );
+		if ( reload->stale )
+		{
+			m_StartReload( reload->mesh );
+		}
+		else if ( reload->success )
+		{
+			if ( MeshResource* mesh = resources.Get( reload->mesh ) )
+			{
+				mesh->Initialize( &reload->vertices, &reload->indices );
+				if ( Level* level = registry.try_get< Level >( this->level ) )
+				{
+					level->RebuildMesh( &resources, reload->mesh );
+				}
+				AE_INFO( "Reloaded '#' in #ms", reload->path, (uint32_t)( ( ae::GetTime() - reload->startTime ) * 1000.0 ) );
+			}
+		}
+		ae::Delete( reload );
 	}
 }
 
-bool Game::IsOnScreen( ae::Vec3 pos ) const
+void Game::m_StartReload( MeshHandle mesh )
 {
-	float halfWidth = render.GetAspectRatio();
-	float halfHeight = 1.0f;
-	if ( -halfWidth < pos.x && pos.x < halfWidth && -halfHeight < pos.y && pos.y < halfHeight )
+	if ( !resources.Get( mesh ) )
 	{
-		return true;
+		return;
 	}
-	else
+	for ( PendingReload* reload : m_pendingReloads )
 	{
-		return false;
+		if ( reload->mesh == mesh )
+		{
+			reload->stale = true;
+			return;
+		}
+	}
+	PendingReload* reload = ae::New< PendingReload >( TAG_GAME );
+	reload->mesh = mesh;
+	reload->path = resources.GetPath( mesh );
+	reload->startTime = ae::GetTime();
+	m_pendingReloads.Append( reload );
+	{
+		std::lock_guard< std::mutex > lock( m_reloadLock );
+		m_reloadQueue.Append( reload );
+	}
+	m_reloadWake.notify_one();
+}
+
+void Game::m_ReloadMain()
+{
+	std::unique_lock< std::mutex > lock( m_reloadLock );
+	while ( true )
+	{
+		m_reloadWake.wait( lock, [ this ]() { return m_reloadQueue.Length() || m_reloadQuit; } );
+		if ( m_reloadQuit )
+		{
+			return;
+		}
+		PendingReload* reload = m_reloadQueue[ 0 ];
+		m_reloadQueue.Remove( 0 );
+		lock.unlock();
+		reload->success = MeshResource::Load( &file, reload->path.c_str(), &reload->vertices, &reload->indices );
+		reload->done = true;
+		lock.lock();
 	}
 }
 
 void Game::Kill( entt::entity entity )
 {
-	m_pendingKill.Set( entity, 0 );
+	killEvents.Push( { entity } );
 }
 
-entt::entity Game::SpawnProjectile( entt::entity source, ae::Vec3 offset )
+CommandBuffer& Game::GetCommands( uint32_t threadIndex )
+{
+	AE_ASSERT( threadIndex < kMaxCommandBuffers );
+	return m_commands[ threadIndex ];
+}
+
+void Game::ApplyCommands()
+{
+	killEvents.Drain( [ this ]( const KillEvent& event )
+	{
+		GetCommands().Destroy( event.entity );
+	} );
+	for ( CommandBuffer& commands : m_commands )
+	{
+		commands.Apply( &registry );
+	}
+}
+
+void Game::m_ProcessEvents()
+{
+	// Cost scales with the number of events raised this tick, not the number of entities
+	const bool anySleeping = GetSleepingBodyCount();
+	hitEvents.Drain( [ this, anySleeping ]( const HitEvent& event )
+	{
+		if ( anySleeping )
+		{
+			WakeNear( registry.get< Transform >( event.entity ).GetPosition(), 2.0f );
+		}
+		if ( registry.all_of< Projectile >( event.entity ) )
+		{
+			Kill( event.entity );
+		}
+	} );
+	// A projectile can both hit and expire in one tick, killing it twice is
+	// harmless and it is only counted when destroyed
+	expireEvents.Drain( [ this ]( const ExpireEvent& event )
+	{
+		Kill( event.entity );
+	} );
+	fireEvents.Drain( [ this ]( const FireEvent& event )
+	{
+		if ( registry.valid( event.source ) )
+		{
+			SpawnProjectile( event.source, event.offset );
+		}
+	} );
+}
+
+void Game::m_UpdateSimLod()
+{
+	// Distance beyond which each tier after Full is used, and its update interval in ticks
+	const float kTierDistances[ SimLod::TierCount - 1 ] = { 25.0f, 60.0f };
+	const uint32_t kTierIntervals[ SimLod::TierCount ] = { 1, 4, 16 };
+	const float kHysteresis = 1.1f;
+	// Tiers are only re-evaluated for an eighth of the entities each tick
+	const uint32_t kEvaluateInterval = 8;
+	
+	ae::Vec2 observers[ 2 ];
+	uint32_t observerCount = 0;
+	if ( const Transform* transform = registry.valid( localShip ) ? registry.try_get< Transform >( localShip ) : nullptr )
+	{
+		observers[ observerCount++ ] = transform->GetPosition().GetXY();
+	}
+	for( auto [ entity, camera, transform ] : registry.view< Camera, Transform >().each() )
+	{
+		if ( observerCount < countof( observers ) )
+		{
+			observers[ observerCount++ ] = transform.GetPosition().GetXY();
+		}
+	}
+	
+	m_tick++;
+	for ( uint32_t& count : m_simLodCounts )
+	{
+		count = 0;
+	}
+	for( auto [ entity, simLod, transform ] : registry.view< SimLod, Transform >().each() )
+	{
+		// Phase comes from the entity index so each tier's updates are spread evenly across ticks
+		const uint32_t phase = (uint32_t)entt::to_integral( entity );
+		if ( observerCount && ( m_tick + phase ) % kEvaluateInterval == 0 )
+		{
+			const ae::Vec2 pos = transform.GetPosition().GetXY();
+			float distanceSq = ae::MaxValue< float >();
+			for ( uint32_t i = 0; i < observerCount; i++ )
+			{
+				distanceSq = ae::Min( distanceSq, ( observers[ i ] - pos ).LengthSquared() );
+			}
+			const float distance = sqrtf( distanceSq );
+			uint32_t tier = simLod.tier;
+			while ( tier + 1 < SimLod::TierCount && distance > kTierDistances[ tier ] * kHysteresis )
+			{
+				tier++;
+			}
+			while ( tier > SimLod::Full && distance < kTierDistances[ tier - 1 ] / kHysteresis )
+			{
+				tier--;
+			}
+			simLod.tier = tier;
+		}
+		
+		// dt is measured from the previous update, so changing tier never loses or repeats time
+		simLod.due = ( m_tick + phase ) % kTierIntervals[ simLod.tier ] == 0;
+		if ( simLod.due )
+		{
+			simLod.dt = ( simLod.lastTime < 0.0 ) ? timeStep.GetDt() : (float)( m_simTime - simLod.lastTime );
+			simLod.lastTime = m_simTime;
+		}
+		m_simLodCounts[ simLod.tier ]++;
+	}
+}
+
+float Game::GetUpdateDt( entt::entity entity ) const
+{
+	if ( const SimLod* simLod = registry.try_get< SimLod >( entity ) )
+	{
+		return simLod->due ? ae::Max( simLod->dt, kMinUpdateDt ) : 0.0f;
+	}
+	return ae::Max( timeStep.GetDt(), kMinUpdateDt );
+}
+
+void Game::Wake( entt::entity entity )
+{
+	// Bodies that are already awake are common, so don't queue them
+	if ( registry.all_of< Sleeping >( entity ) )
+	{
+		m_wakeEntities.Append( entity );
+	}
+}
+
+void Game::WakeNear( ae::Vec3 pos, float radius )
+{
+	if ( m_sleepGridDirty )
+	{
+		m_BuildSleepGrid();
+	}
+	const int32_t minX = (int32_t)floorf( ( pos.x - radius ) / kSleepCellSize );
+	const int32_t maxX = (int32_t)floorf( ( pos.x + radius ) / kSleepCellSize );
+	const int32_t minY = (int32_t)floorf( ( pos.y - radius ) / kSleepCellSize );
+	const int32_t maxY = (int32_t)floorf( ( pos.y + radius ) / kSleepCellSize );
+	for ( int32_t y = minY; y <= maxY; y++ )
+	{
+		for ( int32_t x = minX; x <= maxX; x++ )
+		{
+			const uint64_t cell = ( (uint64_t)(uint32_t)x << 32 ) | (uint32_t)y;
+			const SleepCell* end = m_sleepGrid.end();
+			const SleepCell* iter = std::lower_bound( m_sleepGrid.begin(), end, cell, []( const SleepCell& c, uint64_t value ) { return c.cell < value; } );
+			for ( ; iter != end && iter->cell == cell; iter++ )
+			{
+				const Transform* transform = registry.valid( iter->entity ) ? registry.try_get< Transform >( iter->entity ) : nullptr;
+				if ( transform && ( transform->GetPosition() - pos ).LengthSquared() <= radius * radius )
+				{
+					Wake( iter->entity );
+				}
+			}
+		}
+	}
+}
+
+uint32_t Game::GetActiveBodyCount()
+{
+	return (uint32_t)GetPhysicsGroup( registry ).size();
+}
+
+uint32_t Game::GetSleepingBodyCount()
+{
+	return (uint32_t)registry.view< Sleeping >().size();
+}
+
+void Game::m_ApplyWakes()
+{
+	for ( entt::entity entity : m_wakeEntities )
+	{
+		// Woken more than once, or destroyed since
+		if ( registry.valid( entity ) && registry.all_of< Sleeping >( entity ) )
+		{
+			registry.remove< Sleeping >( entity );
+			registry.get< Physics >( entity ).restingTicks = 0;
+			m_sleepGridDirty = true;
+		}
+	}
+	m_wakeEntities.Clear();
+}
+
+void Game::m_ApplySleeps()
+{
+	for ( entt::entity entity : m_sleepEntities )
+	{
+		if ( !registry.all_of< Sleeping >( entity ) )
+		{
+			Physics& physics = registry.get< Physics >( entity );
+			physics.vel = ae::Vec3( 0.0f );
+			physics.rotationVel = 0.0f;
+			registry.emplace< Sleeping >( entity );
+			m_sleepGridDirty = true;
+		}
+	}
+	m_sleepEntities.Clear();
+}
+
+void Game::m_BuildSleepGrid()
+{
+	m_sleepGrid.Clear();
+	for ( auto [ entity, sleeping, transform ] : registry.view< Sleeping, Transform >().each() )
+	{
+		ae::Vec3 pos = transform.GetPosition();
+		const int32_t x = (int32_t)floorf( pos.x / kSleepCellSize );
+		const int32_t y = (int32_t)floorf( pos.y / kSleepCellSize );
+		m_sleepGrid.Append( { ( (uint64_t)(uint32_t)x << 32 ) | (uint32_t)y, entity } );
+	}
+	std::sort( m_sleepGrid.begin(), m_sleepGrid.end(), []( const SleepCell& a, const SleepCell& b ) { return a.cell < b.cell; } );
+	m_sleepGridDirty = false;
+}
+
+void Game::m_OnProjectileCreated( entt::registry& registry, entt::entity entity )
+{
+	Projectile& projectile = registry.get< Projectile >( entity );
+	if ( projectile.lifetimeTicks )
+	{
+		projectile.expireTick = timers.Schedule( entity, projectile.lifetimeTicks );
+	}
+}
+
+void Game::m_OnProjectileDestroyed( entt::registry& registry, entt::entity entity )
+{
+	// Every way a projectile is destroyed ends up here exactly once, so dead
+	// projectiles don't leave timers in the wheel
+	const Projectile& projectile = registry.get< Projectile >( entity );
+	if ( projectile.expireTick )
+	{
+		timers.Cancel( entity, projectile.expireTick );
+	}
+	telemetry.Add( TelemetryCounter::ProjectilesKilled );
+}
+
+void Game::SpawnProjectile( entt::entity source, ae::Vec3 offset )
 {
 	const Transform& sourceTransform = registry.get< Transform >( source );
 	const Team& sourceTeam = registry.get< Team >( source );
 	const Physics* sourcePhysics = registry.try_get< Physics >( source );
 	
-	entt::entity entity = registry.create();
+	CommandBuffer& commands = GetCommands();
+	uint32_t entity = commands.Create();
+	telemetry.Add( TelemetryCounter::ProjectilesSpawned );
 
-	Transform& transform = registry.emplace< Transform >( entity );
+	Transform transform;
 	offset = ( sourceTransform.transform * ae::Vec4( offset, 0.0f ) ).GetXYZ();
 	transform.SetPosition( sourceTransform.GetPosition() + offset );
 	transform.transform.SetRotation( sourceTransform.transform.GetRotation() );
 	transform.transform.SetScale( ae::Vec3( 0.25f ) );
+	commands.Emplace( entity, transform );
 	
-	Physics& physics = registry.emplace< Physics >( entity );
+	Physics physics;
 	if ( sourcePhysics )
 	{
 		physics.vel += sourcePhysics->vel;
 	}
 	physics.vel += sourceTransform.GetForward() * 15.0f;
 	physics.collisionRadius = 0.1f;
+	physics.prevPos = transform.GetPosition();
+	commands.Emplace( entity, physics );
 	
-	Projectile& projectile = registry.emplace< Projectile >( entity );
-	projectile.killTime = ae::GetTime() + 2.0f;
+	Projectile projectile;
+	projectile.lifetimeTicks = (uint32_t)( 2.0f / timeStep.GetTimeStep() );
+	commands.Emplace( entity, projectile );
 	
-	Team& team = registry.emplace< Team >( entity );
+	Team team;
 	team.teamId = sourceTeam.teamId;
+	commands.Emplace( entity, team );
 
-	Model& model = registry.emplace< Model >( entity );
-	model.mesh = &shipModel;
-	model.shader = &shader;
+	Model model;
+	model.mesh = shipMesh;
+	model.shader = shader;
 	switch ( sourceTeam.teamId )
 	{
 		case TeamId::None:
@@ -286,6 +1162,5 @@ entt::entity Game::SpawnProjectile( entt::entity source, ae::Vec3 offset )
 			AE_FAIL_MSG( "Invalid team" );
 			break;
 	}
-	
-	return entity;
+	commands.Emplace( entity, model );
 }
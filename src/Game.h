@@ -2,11 +2,23 @@
 #define ASTEROIDS_GAME_H
 
 #include "ae/aether.h"
+#include "AiController.h"
+#include "CommandBuffer.h"
+#include "Events.h"
+#include "FileWatcher.h"
+#include "Jobs.h"
 #include "Level.h"
+#include "RenderState.h"
+#include "ResourceManager.h"
 #include "Resources.h"
+#include "Telemetry.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 const ae::Tag TAG_GAME = "game";
-const ae::Tag TAG_RESOURCE = "resource";
+// Debug lines of the render state currently being simulated, may be null
 ae::DebugLines*& GetDebugLines();
 
 enum class TeamId
@@ -21,38 +33,183 @@ class Game
 public:
 	void Initialize();
 	void Terminate();
+	// Loads the default scene
 	void Load();
+	// Loads a data relative scenario file, see Scenario.h
+	bool LoadScenario( const char* path );
 	void Run();
 	
-	bool IsOnScreen( ae::Vec3 pos ) const;
+	// Moves positions that have left the asteroid field to the opposite side of
+	// it. The field is the bounding box of every asteroid spawn area in the
+	// current scene. Returns true if the position was changed.
+	bool WrapToAsteroidField( ae::Vec3* pos ) const;
 	
+	// Structural changes are deferred until the next ApplyCommands() sync point.
+	// Kill() is safe to call from job system threads.
 	void Kill( entt::entity entity );
-	entt::entity SpawnProjectile( entt::entity entity, ae::Vec3 offset );
+	// Moves a sleeping body back into the physics group at the start of the next
+	// physics update. Call after changing the motion of a body that may be asleep.
+	void Wake( entt::entity entity );
+	// Wakes sleeping bodies within radius of pos, used when something collides nearby
+	void WakeNear( ae::Vec3 pos, float radius );
+	uint32_t GetActiveBodyCount();
+	uint32_t GetSleepingBodyCount();
+	// Seconds to advance the entity by this tick, 0 if its SimLod isn't due
+	float GetUpdateDt( entt::entity entity ) const;
+	void SpawnProjectile( entt::entity entity, ae::Vec3 offset );
+	// Bulk spawning used by Load() and scenarios. Entities are placed uniformly
+	// within radius of center.
+	Level& GetOrCreateLevel();
+	void SpawnCamera();
+	// Ships that aren't local are steered by the AI controller. Only a single
+	// ship can be spawned as local.
+	void SpawnShips( uint32_t count, ae::Vec2 center, float radius, bool local, TeamId teamId = TeamId::Enemy );
+	void SpawnTurrets( uint32_t count, ae::Vec2 center, float radius );
+	void SpawnAsteroids( uint32_t count, ae::Vec2 center, float radius );
+	// Loads a mesh from its data path, or "asteroid" for the built-in asteroid,
+	// and watches the file for changes. The reference is owned by the current
+	// scene and released by the next Load() or LoadScenario().
+	MeshHandle LoadMesh( const char* path );
+	
+	// Systems running on worker threads should each record into their own buffer
+	CommandBuffer& GetCommands( uint32_t threadIndex = 0 );
+	// Also drains kill events into the command buffers first
+	void ApplyCommands();
 	
 	// Systems
 	ae::Window window;
 	ae::GraphicsDevice render;
-	ae::DebugLines debugLines;
 	ae::Input input;
 	ae::FileSystem file;
 	ae::TimeStep timeStep;
+	JobSystem jobs;
+	Telemetry telemetry;
+	ResourceManager resources;
 	entt::registry registry;
 	
+	// Events raised during the current tick, each is drained once per tick
+	EventQueue< HitEvent > hitEvents;
+	EventQueue< ExpireEvent > expireEvents;
+	EventQueue< FireEvent > fireEvents;
+	EventQueue< KillEvent > killEvents;
+	TimerWheel timers;
+	
 	// Game state
 	entt::entity level = entt::entity();
 	entt::entity localShip = entt::entity();
 	ae::Matrix4 worldToNdc = ae::Matrix4::Identity();
+	// Copied from the graphics device on the main thread before each tick, so
+	// the simulation never queries the device
+	float aspectRatio = 1.0f;
 	ae::Color ambientLight = ae::Color::White();
+	// Simulate the next tick on the simulation thread while the main thread
+	// draws the previous one. Toggled with F3.
+	bool pipelined = true;
+	// Sleeps before sampling input so that the frame finishes just before its
+	// deadline, minimizing input to present latency. Pipelining is not used
+	// while this is on. Toggled with F4.
+	bool lowLatency = false;
+	
+	// Resources used by spawned entities, loaded for the lifetime of the game
+	ShaderHandle shader;
+	UniformLayout shaderLayout;
+	MeshHandle shipMesh;
+	MeshHandle asteroidMesh;
 	
-	// Resources
-	ae::Shader shader;
-	MeshResource level0;
-	MeshResource cubeModel;
-	MeshResource shipModel;
-	MeshResource asteroidModel;
+	// Render stats for the last frame, fullTriangleCount is the count without LODs
+	uint32_t triangleCount = 0;
+	uint32_t fullTriangleCount = 0;
 	
 private:
-	ae::Map< entt::entity, int > m_pendingKill = TAG_GAME;
+	void m_BeginLoad();
+	// Updates every system and writes the result to stateOut. Runs on the
+	// simulation thread when pipelined, and must not touch the graphics device.
+	void m_Simulate( RenderState* stateOut );
+	void m_Extract( RenderState* stateOut );
+	void m_Render( RenderState* state );
+	void m_StartSimulation( RenderState* stateOut );
+	void m_FinishSimulation();
+	void m_SimulationMain();
+	void m_ProcessEvents();
+	void m_UpdateSimLod();
+	void m_ApplyWakes();
+	void m_ApplySleeps();
+	void m_BuildSleepGrid();
+	void m_OnProjectileCreated( entt::registry& registry, entt::entity entity );
+	void m_OnProjectileDestroyed( entt::registry& registry, entt::entity entity );
+	const ae::Array< entt::entity >& m_CreateEntities( uint32_t count, ae::Vec2 center, float radius );
+	void m_UpdateLineOfSight();
+	void m_UpdateHotReload();
+	void m_StartReload( MeshHandle mesh );
+	void m_ReloadMain();
+	// Sleeps until the estimated frame cost is all that is left before the deadline
+	void m_WaitForLateInput( double deadline );
+	void m_UpdateFrameCost( double cost );
+	void m_LogLatency() const;
+	
+	// Meshes are re-imported one at a time on a single background thread when
+	// their file changes and swapped in at the start of a frame
+	struct PendingReload
+	{
+		MeshHandle mesh;
+		ae::Str256 path;
+		double startTime = 0.0;
+		std::atomic< bool > done = { false };
+		bool success = false;
+		bool stale = false; // Changed again while loading
+		ae::Array< Vertex > vertices = TAG_RESOURCE;
+		ae::Array< uint16_t > indices = TAG_RESOURCE;
+	};
+	FileWatcher m_fileWatcher;
+	ae::Array< PendingReload* > m_pendingReloads = TAG_GAME;
+	std::thread m_reloadThread;
+	std::mutex m_reloadLock;
+	std::condition_variable m_reloadWake;
+	ae::Array< PendingReload* > m_reloadQueue = TAG_GAME; // Not started yet, guarded by m_reloadLock
+	bool m_reloadQuit = false;
+	ae::Array< ae::Str256 > m_changedFiles = TAG_GAME;
+	// References held by the current scene, see LoadMesh()
+	ae::Array< MeshHandle > m_sceneMeshes = TAG_GAME;
+	
+	RenderState m_renderStates[ 2 ];
+	uint32_t m_simStateIndex = 0;
+	std::thread m_simThread;
+	std::mutex m_simLock;
+	std::condition_variable m_simWake;
+	std::condition_variable m_simDone;
+	RenderState* m_simState = nullptr; // Non-null while a tick is pending or running
+	bool m_simQuit = false;
+	
+	static const uint32_t kMaxCommandBuffers = JobSystem::kMaxThreads;
+	CommandBuffer m_commands[ kMaxCommandBuffers ];
+	AiController m_aiController;
+	ae::Array< entt::entity > m_spawnEntities = TAG_GAME;
+	
+	// Input sampling and latency, see lowLatency
+	double m_inputTime = 0.0;
+	double m_frameCost = 0.0; // Smoothed seconds from sampling input to the end of the frame
+	double m_frameCostDeviation = 0.0;
+	double m_latencySum = 0.0;
+	double m_latencyMax = 0.0;
+	uint32_t m_latencyCount = 0;
+	
+	uint64_t m_tick = 0;
+	double m_simTime = 0.0; // Sum of every tick's dt
+	uint32_t m_simLodCounts[ 3 ] = {}; // Indexed by SimLod::Tier
+	ae::Vec2 m_asteroidFieldMin = ae::Vec2( ae::MaxValue< float >() );
+	ae::Vec2 m_asteroidFieldMax = ae::Vec2( -ae::MaxValue< float >() );
+	
+	// Sleeping bodies are only added and removed between physics passes
+	ae::Array< entt::entity > m_wakeEntities = TAG_GAME;
+	ae::Array< entt::entity > m_sleepEntities = TAG_GAME;
+	// Sleeping bodies sorted by grid cell for WakeNear(), rebuilt when needed
+	struct SleepCell
+	{
+		uint64_t cell;
+		entt::entity entity;
+	};
+	ae::Array< SleepCell > m_sleepGrid = TAG_GAME;
+	bool m_sleepGridDirty = true;
 };
 
 #endif
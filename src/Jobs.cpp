@@ -0,0 +1,131 @@
+#include "Jobs.h"
+
+static thread_local uint32_t s_threadIndex = 0;
+
+//------------------------------------------------------------------------------
+// JobSystem member functions
+//------------------------------------------------------------------------------
+void JobSystem::Initialize( uint32_t workerCount )
+{
+	if ( !workerCount )
+	{
+		uint32_t hardwareCount = std::thread::hardware_concurrency();
+		workerCount = hardwareCount ? hardwareCount - 1 : 0;
+	}
+	m_workerCount = ae::Min( workerCount, kMaxThreads - 1 );
+	m_quit = false;
+	for ( uint32_t i = 0; i < m_workerCount; i++ )
+	{
+		m_workers[ i ] = std::thread( &JobSystem::m_WorkerMain, this, i + 1 );
+	}
+}
+
+void JobSystem::Terminate()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_lock );
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for ( uint32_t i = 0; i < m_workerCount; i++ )
+	{
+		m_workers[ i ].join();
+	}
+	m_workerCount = 0;
+}
+
+uint32_t JobSystem::GetThreadIndex()
+{
+	return s_threadIndex;
+}
+
+void JobSystem::ParallelFor( uint32_t count, uint32_t chunkSize, const ForFn& fn )
+{
+	if ( !count )
+	{
+		return;
+	}
+	chunkSize = ae::Max( chunkSize, 1u );
+	const uint32_t chunkCount = ( count + chunkSize - 1 ) / chunkSize;
+	if ( !m_workerCount || chunkCount == 1 || !m_dispatchLock.try_lock() )
+	{
+		fn( 0, count, s_threadIndex );
+		return;
+	}
+
+	Job job;
+	{
+		std::lock_guard< std::mutex > lock( m_lock );
+		m_generation++;
+		m_job.fn = &fn;
+		m_job.count = count;
+		m_job.chunkSize = chunkSize;
+		m_job.chunkCount = chunkCount;
+		m_job.generation = m_generation;
+		m_pendingChunks = chunkCount;
+		m_nextChunk = (uint64_t)m_generation << 32; // Publishes the job to workers that are already running
+		job = m_job;
+	}
+	m_wake.notify_all();
+
+	m_RunChunks( job, s_threadIndex );
+
+	{
+		std::unique_lock< std::mutex > lock( m_lock );
+		m_done.wait( lock, [ this ]() { return !m_pendingChunks && !m_busyWorkers; } );
+		m_job.fn = nullptr;
+	}
+	m_dispatchLock.unlock();
+}
+
+void JobSystem::m_WorkerMain( uint32_t threadIndex )
+{
+	s_threadIndex = threadIndex;
+	uint32_t generation = 0;
+	while ( true )
+	{
+		Job job;
+		{
+			std::unique_lock< std::mutex > lock( m_lock );
+			m_wake.wait( lock, [ this, generation ]() { return m_quit || m_generation != generation; } );
+			if ( m_quit )
+			{
+				return;
+			}
+			generation = m_generation;
+			job = m_job;
+			m_busyWorkers++;
+		}
+		m_RunChunks( job, threadIndex );
+		{
+			std::lock_guard< std::mutex > lock( m_lock );
+			m_busyWorkers--;
+		}
+		m_done.notify_all();
+	}
+}
+
+void JobSystem::m_RunChunks( const Job& job, uint32_t threadIndex )
+{
+	while ( true )
+	{
+		// Stops once the job is finished or a newer job has been published, a
+		// stale thread never advances the counter of a newer job
+		uint64_t next = m_nextChunk.load();
+		do
+		{
+			if ( ( next >> 32 ) != job.generation || (uint32_t)next >= job.chunkCount )
+			{
+				return;
+			}
+		} while ( !m_nextChunk.compare_exchange_weak( next, next + 1 ) );
+		uint32_t begin = (uint32_t)next * job.chunkSize;
+		uint32_t end = ae::Min( begin + job.chunkSize, job.count );
+		( *job.fn )( begin, end, threadIndex );
+		if ( m_pendingChunks.fetch_sub( 1 ) == 1 )
+		{
+			std::lock_guard< std::mutex > lock( m_lock );
+			m_done.notify_all();
+		}
+	}
+}
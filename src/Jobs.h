@@ -0,0 +1,67 @@
+#ifndef ASTEROIDS_JOBS_H
+#define ASTEROIDS_JOBS_H
+
+#include "ae/aether.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//------------------------------------------------------------------------------
+// JobSystem class
+//------------------------------------------------------------------------------
+// Small pool of persistent worker threads for data parallel loops. Thread index
+// 0 is always the thread that called ParallelFor(), workers are 1 and up, so
+// the index can be used to pick per-thread scratch data such as command buffers.
+class JobSystem
+{
+public:
+	static constexpr uint32_t kMaxThreads = 8;
+	using ForFn = std::function< void( uint32_t begin, uint32_t end, uint32_t threadIndex ) >;
+
+	// Zero threads picks one less than the hardware concurrency
+	void Initialize( uint32_t workerCount = 0 );
+	void Terminate();
+
+	// Splits [0,count) into chunks and runs them across the workers and the
+	// calling thread, returning once every chunk has completed. Nested or
+	// concurrent calls run serially on the calling thread.
+	void ParallelFor( uint32_t count, uint32_t chunkSize, const ForFn& fn );
+	uint32_t GetThreadCount() const { return m_workerCount + 1; }
+	// Index of the calling thread, 0 for any thread that is not a worker
+	static uint32_t GetThreadIndex();
+
+private:
+	// Copied by each thread under m_lock, so a worker that wakes late never
+	// mixes the parameters of two jobs
+	struct Job
+	{
+		const ForFn* fn = nullptr;
+		uint32_t count = 0;
+		uint32_t chunkSize = 0;
+		uint32_t chunkCount = 0;
+		uint32_t generation = 0;
+	};
+	void m_WorkerMain( uint32_t threadIndex );
+	void m_RunChunks( const Job& job, uint32_t threadIndex );
+
+	std::thread m_workers[ kMaxThreads - 1 ];
+	uint32_t m_workerCount = 0;
+	std::mutex m_dispatchLock;
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	bool m_quit = false;
+	uint32_t m_generation = 0;
+
+	// Current job, guarded by m_lock
+	Job m_job;
+	// Generation in the high 32 bits and next chunk in the low 32 bits, so a
+	// chunk can only be claimed by a thread running the same job
+	std::atomic< uint64_t > m_nextChunk = { 0 };
+	std::atomic< uint32_t > m_pendingChunks = { 0 };
+	uint32_t m_busyWorkers = 0;
+};
+
+#endif
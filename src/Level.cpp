@@ -1,6 +1,7 @@
 #include "Level.h"
 #include "Components.h"
 #include "Game.h"
+#include "Jobs.h"
 #include "Resources.h"
 
 ae::Vec3 Level::Line::GetNormal() const
@@ -58,31 +59,183 @@ bool TrianglePlaneIntersection( ae::Vec3 p, ae::Vec3 n, const ae::Vec3* t, ae::V
 	return false;
 }
 
-void Level::AddMesh( const MeshResource* mesh, ae::Matrix4 localToWorld )
+bool RayCircleIntersection( ae::Vec2 p, ae::Vec2 d, ae::Vec2 center, float radius, float* tOut )
 {
+	ae::Vec2 m = p - center;
+	float a = d.Dot( d );
+	float b = m.Dot( d );
+	float c = m.Dot( m ) - radius * radius;
+	if ( a <= 0.0f || c < 0.0f || b > 0.0f )
+	{
+		// Degenerate ray, starting inside the circle, or moving away from it
+		return false;
+	}
+	float discr = b * b - a * c;
+	if ( discr < 0.0f )
+	{
+		return false;
+	}
+	float t = ( -b - sqrtf( discr ) ) / a;
+	if ( t < 0.0f || t > 1.0f )
+	{
+		return false;
+	}
+	*tOut = t;
+	return true;
+}
+
+void Level::AddMesh( ResourceManager* resources, MeshHandle mesh, ae::Matrix4 localToWorld )
+{
+	const MeshResource* meshResource = resources->Get( mesh );
+	if ( !meshResource )
+	{
+		return;
+	}
 	LevelMesh& levelMesh = m_levelMeshes.Append( LevelMesh() );
 	levelMesh.mesh = mesh;
 	levelMesh.localToWorld = localToWorld;
+	levelMesh.collisionStart = m_collision.Length();
+	m_Slice( meshResource, levelMesh, &m_collision );
+	levelMesh.collisionCount = m_collision.Length() - levelMesh.collisionStart;
 	
+	m_BuildGrid();
+}
+
+void Level::RebuildMesh( ResourceManager* resources, MeshHandle mesh )
+{
+	const MeshResource* meshResource = resources->Get( mesh );
+	if ( !meshResource )
+	{
+		return;
+	}
+	bool found = false;
 	for ( const LevelMesh& levelMesh : m_levelMeshes )
 	{
-		uint32_t triCount = levelMesh.mesh->vertexData.GetIndexCount() / 3;
-		AE_ASSERT( levelMesh.mesh->vertexData.GetIndexSize() == 2 );
-		AE_ASSERT( sizeof(Vertex) == levelMesh.mesh->vertexData.GetVertexSize() );
-		const uint16_t* indices = (const uint16_t*)levelMesh.mesh->vertexData.GetIndices();
-		const Vertex* verts = (const Vertex*)levelMesh.mesh->vertexData.GetVertices();
-		for ( uint32_t i = 0; i < triCount; i++ )
-		{
-			ae::Vec3 p0, p1;
-			ae::Vec3 t[ 3 ];
-			t[ 0 ] = ( levelMesh.localToWorld * verts[ indices[ i * 3 ] ].pos ).GetXYZ();
-			t[ 1 ] = ( levelMesh.localToWorld * verts[ indices[ i * 3 + 1 ] ].pos ).GetXYZ();
-			t[ 2 ] = ( levelMesh.localToWorld * verts[ indices[ i * 3 + 2 ] ].pos ).GetXYZ();
-			if ( TrianglePlaneIntersection( ae::Vec3( 0.0f ), ae::Vec3( 0,0,1 ), t, &p0, &p1 ) )
+		found = found || ( levelMesh.mesh == mesh );
+	}
+	if ( !found )
+	{
+		return;
+	}
+	
+	// Only level meshes using the changed resource are sliced again, the
+	// collision of every other level mesh is copied as is
+	ae::Array< Line > collision( TAG_LEVEL, m_collision.Length() );
+	for ( LevelMesh& levelMesh : m_levelMeshes )
+	{
+		uint32_t start = collision.Length();
+		if ( levelMesh.mesh == mesh )
+		{
+			m_Slice( meshResource, levelMesh, &collision );
+		}
+		else
+		{
+			collision.Append( m_collision.Begin() + levelMesh.collisionStart, levelMesh.collisionCount );
+		}
+		levelMesh.collisionStart = start;
+		levelMesh.collisionCount = collision.Length() - start;
+	}
+	std::swap( m_collision, collision );
+	
+	m_BuildGrid();
+}
+
+void Level::m_Slice( const MeshResource* mesh, const LevelMesh& levelMesh, ae::Array< Line >* linesOut ) const
+{
+	uint32_t triCount = mesh->indices.Length() / 3;
+	const uint16_t* indices = mesh->indices.Begin();
+	const Vertex* verts = mesh->vertices.Begin();
+	for ( uint32_t i = 0; i < triCount; i++ )
+	{
+		ae::Vec3 p0, p1;
+		ae::Vec3 t[ 3 ];
+		t[ 0 ] = ( levelMesh.localToWorld * verts[ indices[ i * 3 ] ].pos ).GetXYZ();
+		t[ 1 ] = ( levelMesh.localToWorld * verts[ indices[ i * 3 + 1 ] ].pos ).GetXYZ();
+		t[ 2 ] = ( levelMesh.localToWorld * verts[ indices[ i * 3 + 2 ] ].pos ).GetXYZ();
+		if ( TrianglePlaneIntersection( ae::Vec3( 0.0f ), ae::Vec3( 0,0,1 ), t, &p0, &p1 ) )
+		{
+			linesOut->Append( { p0, p1 } );
+		}
+	}
+}
+
+bool Level::Sweep( ae::Vec3 p0, ae::Vec3 p1, float radius, float* tOut, ae::Vec3* normalOut ) const
+{
+	bool hit = false;
+	float closestT = ae::MaxValue< float >();
+	ae::Vec2 closestNormal;
+	
+	const ae::Vec2 start = p0.GetXY();
+	const ae::Vec2 d = ( p1 - p0 ).GetXY();
+	for ( const Line& l : m_collision )
+	{
+		const ae::Vec2 a = l.p0.GetXY();
+		const ae::Vec2 b = l.p1.GetXY();
+		ae::Vec2 D = b - a;
+		float len = D.SafeNormalize();
+		if ( len <= 0.0f )
+		{
+			continue;
+		}
+		const ae::Vec2 n( D.y, -D.x );
+		
+		// Segment face, offset towards whichever side the circle starts on
+		float startDist = ( start - a ).Dot( n );
+		float side = ( startDist < 0.0f ) ? -1.0f : 1.0f;
+		float approach = d.Dot( n ) * side;
+		if ( startDist * side >= radius && approach < 0.0f )
+		{
+			float t = ( startDist * side - radius ) / -approach;
+			float u = ( start + d * t - a ).Dot( D );
+			if ( t <= 1.0f && 0.0f <= u && u <= len && t < closestT )
 			{
-				m_collision.Append( { p0, p1 } );
+				closestT = t;
+				closestNormal = n * side;
+				hit = true;
 			}
 		}
+		
+		// Segment end caps
+		const ae::Vec2 caps[] = { a, b };
+		for ( ae::Vec2 cap : caps )
+		{
+			float t;
+			if ( RayCircleIntersection( start, d, cap, radius, &t ) && t < closestT )
+			{
+				closestT = t;
+				closestNormal = ( start + d * t - cap ).SafeNormalizeCopy();
+				hit = true;
+			}
+		}
+	}
+	
+	if ( hit )
+	{
+		*tOut = closestT;
+		*normalOut = ae::Vec3( closestNormal.x, closestNormal.y, 0.0f );
+	}
+	return hit;
+}
+
+void Level::Raycast( const Ray* rays, RayHit* hitsOut, uint32_t count, JobSystem* jobs ) const
+{
+	const uint32_t kChunkSize = 64;
+	if ( jobs && count > kChunkSize )
+	{
+		jobs->ParallelFor( count, kChunkSize, [ this, rays, hitsOut ]( uint32_t begin, uint32_t end, uint32_t threadIndex )
+		{
+			for ( uint32_t i = begin; i < end; i++ )
+			{
+				hitsOut[ i ] = m_Raycast( rays[ i ] );
+			}
+		} );
+	}
+	else
+	{
+		for ( uint32_t i = 0; i < count; i++ )
+		{
+			hitsOut[ i ] = m_Raycast( rays[ i ] );
+		}
 	}
 }
 
@@ -95,6 +248,24 @@ bool Level::Test( Transform* transform, Physics* physics )
 	
 	ae::DebugLines* debugLines = GetDebugLines();
 	ae::Vec3 pos = transform->GetPosition();
+	
+	// Fast movers can step past thin geometry entirely, so sweep them from
+	// their previous position and stop them at the time of impact
+	bool swept = false;
+	ae::Vec3 step = pos - physics->prevPos;
+	if ( step.LengthSquared() > physics->collisionRadius * physics->collisionRadius )
+	{
+		float t;
+		ae::Vec3 normal;
+		if ( Sweep( physics->prevPos, pos, physics->collisionRadius, &t, &normal ) )
+		{
+			pos = physics->prevPos + step * t + normal * 0.001f;
+			transform->SetPosition( pos );
+			physics->vel.ZeroDirection( -normal );
+			swept = true;
+		}
+	}
+	
 	for ( const Line& l : m_collision )
 	{
 		// project onto line
@@ -117,37 +288,53 @@ bool Level::Test( Transform* transform, Physics* physics )
 	if ( hit )
 	{
 		ae::Vec3 outer = pos + ( closest - pos ).SafeNormalizeCopy() * physics->collisionRadius;
-		GetDebugLines()->AddSphere( closest, 0.1f, ae::Color::Red(), 8 );
-		GetDebugLines()->AddSphere( outer, 0.1f, ae::Color::Green(), 8 );
-		GetDebugLines()->AddSphere( pos + ( closest - outer ), 0.1f, ae::Color::Blue(), 8 );
+		if ( debugLines )
+		{
+			debugLines->AddSphere( closest, 0.1f, ae::Color::Red(), 8 );
+			debugLines->AddSphere( outer, 0.1f, ae::Color::Green(), 8 );
+			debugLines->AddSphere( pos + ( closest - outer ), 0.1f, ae::Color::Blue(), 8 );
+		}
 		transform->SetPosition( pos + ( closest - outer ) );
 		
 		physics->vel.ZeroDirection( -closestNormal );
 	}
-	GetDebugLines()->AddLine( pos, pos + physics->vel, ae::Color::Green() );
+	if ( debugLines )
+	{
+		debugLines->AddLine( pos, pos + physics->vel, ae::Color::Green() );
+	}
 	
-	return hit;
+	return hit || swept;
 }
 
-void Level::Render( Game* game )
+void Level::Extract( Game* game, RenderState* stateOut )
 {
-	for ( const LevelMesh& levelMesh : m_levelMeshes )
+	const ae::Matrix4& worldToNdc = stateOut->frame.worldToNdc;
+	const ae::Shader* shader = game->resources.Get( game->shader );
+	for ( LevelMesh& levelMesh : m_levelMeshes )
 	{
-		ae::Matrix4 normalMatrix = levelMesh.localToWorld.GetNormalMatrix();
-		ae::UniformList uniformList;
-		uniformList.Set( "u_modelToNdc", game->worldToNdc * levelMesh.localToWorld );
-		uniformList.Set( "u_normalMatrix", normalMatrix );
-		uniformList.Set( "u_ambientLight", game->ambientLight.GetLinearRGB() );
-		uniformList.Set( "u_color", ae::Color::Gray().GetLinearRGB() );
-		levelMesh.mesh->vertexData.Render( &game->shader, uniformList );
-		
-		for ( const Line& l : m_collision )
+		const MeshResource* mesh = game->resources.Get( levelMesh.mesh );
+		if ( !mesh || !shader )
 		{
-			ae::Vec3 n = l.GetNormal();
-			ae::Vec3 c = ( l.p0 + l.p1 ) * 0.5f;
-			game->debugLines.AddLine( l.p0, l.p1, ae::Color::Red() );
-			game->debugLines.AddLine( c, c + n, ae::Color::Red() );
+			continue;
 		}
+		ae::Vec3 scale = levelMesh.localToWorld.GetScale();
+		float radius = mesh->GetRadius() * ae::Max( scale.x, ae::Max( scale.y, scale.z ) );
+		levelMesh.lod = mesh->SelectLod( GetProjectedRadius( worldToNdc, levelMesh.localToWorld.GetTranslation(), radius ), levelMesh.lod );
+		
+		RenderState::Draw& draw = stateOut->draws.Append( RenderState::Draw() );
+		draw.transform = levelMesh.localToWorld;
+		draw.mesh = mesh;
+		draw.shader = shader;
+		draw.color = ae::Color::Gray().GetLinearRGB();
+		draw.lod = levelMesh.lod;
+	}
+	
+	for ( const Line& l : m_collision )
+	{
+		ae::Vec3 n = l.GetNormal();
+		ae::Vec3 c = ( l.p0 + l.p1 ) * 0.5f;
+		stateOut->debugLines.AddLine( l.p0, l.p1, ae::Color::Red() );
+		stateOut->debugLines.AddLine( c, c + n, ae::Color::Red() );
 	}
 }
 
@@ -155,4 +342,196 @@ void Level::Clear()
 {
 	m_levelMeshes.Clear();
 	m_collision.Clear();
+	m_BuildGrid();
+}
+
+void Level::m_BuildGrid()
+{
+	m_gridCellStart.Clear();
+	m_gridLines.Clear();
+	m_gridWidth = 0;
+	m_gridHeight = 0;
+	if ( !m_collision.Length() )
+	{
+		return;
+	}
+	
+	ae::Vec2 min( ae::MaxValue< float >() );
+	ae::Vec2 max( -ae::MaxValue< float >() );
+	for ( const Line& l : m_collision )
+	{
+		min.x = ae::Min( min.x, ae::Min( l.p0.x, l.p1.x ) );
+		min.y = ae::Min( min.y, ae::Min( l.p0.y, l.p1.y ) );
+		max.x = ae::Max( max.x, ae::Max( l.p0.x, l.p1.x ) );
+		max.y = ae::Max( max.y, ae::Max( l.p0.y, l.p1.y ) );
+	}
+	
+	// Cells are roughly the size of a ship, but large levels are capped at 256x256
+	const float kCellSize = 2.0f;
+	const float kMaxCellsPerAxis = 256.0f;
+	ae::Vec2 size = max - min;
+	m_gridCellSize = ae::Max( kCellSize, ae::Max( size.x, size.y ) / kMaxCellsPerAxis );
+	m_gridMin = min;
+	m_gridWidth = (int32_t)( size.x / m_gridCellSize ) + 1;
+	m_gridHeight = (int32_t)( size.y / m_gridCellSize ) + 1;
+	const uint32_t cellCount = m_gridWidth * m_gridHeight;
+	
+	auto getCellRange = [&]( const Line& l, int32_t* x0, int32_t* y0, int32_t* x1, int32_t* y1 )
+	{
+		*x0 = (int32_t)( ( ae::Min( l.p0.x, l.p1.x ) - m_gridMin.x ) / m_gridCellSize );
+		*y0 = (int32_t)( ( ae::Min( l.p0.y, l.p1.y ) - m_gridMin.y ) / m_gridCellSize );
+		*x1 = ae::Min( (int32_t)( ( ae::Max( l.p0.x, l.p1.x ) - m_gridMin.x ) / m_gridCellSize ), m_gridWidth - 1 );
+		*y1 = ae::Min( (int32_t)( ( ae::Max( l.p0.y, l.p1.y ) - m_gridMin.y ) / m_gridCellSize ), m_gridHeight - 1 );
+	};
+	
+	// Count lines per cell, then convert counts to start offsets
+	for ( uint32_t i = 0; i < cellCount + 1; i++ )
+	{
+		m_gridCellStart.Append( 0 );
+	}
+	for ( const Line& l : m_collision )
+	{
+		int32_t x0, y0, x1, y1;
+		getCellRange( l, &x0, &y0, &x1, &y1 );
+		for ( int32_t y = y0; y <= y1; y++ )
+		{
+			for ( int32_t x = x0; x <= x1; x++ )
+			{
+				m_gridCellStart[ y * m_gridWidth + x + 1 ]++;
+			}
+		}
+	}
+	for ( uint32_t i = 0; i < cellCount; i++ )
+	{
+		m_gridCellStart[ i + 1 ] += m_gridCellStart[ i ];
+	}
+	
+	ae::Array< uint32_t > cursor( TAG_LEVEL, cellCount );
+	for ( uint32_t i = 0; i < cellCount; i++ )
+	{
+		cursor.Append( m_gridCellStart[ i ] );
+	}
+	for ( uint32_t i = 0; i < m_gridCellStart[ cellCount ]; i++ )
+	{
+		m_gridLines.Append( 0 );
+	}
+	for ( uint32_t i = 0; i < m_collision.Length(); i++ )
+	{
+		int32_t x0, y0, x1, y1;
+		getCellRange( m_collision[ i ], &x0, &y0, &x1, &y1 );
+		for ( int32_t y = y0; y <= y1; y++ )
+		{
+			for ( int32_t x = x0; x <= x1; x++ )
+			{
+				m_gridLines[ cursor[ y * m_gridWidth + x ]++ ] = i;
+			}
+		}
+	}
+}
+
+bool ClipRaySlab( float p, float d, float min, float max, float* tEnter, float* tExit )
+{
+	if ( d == 0.0f )
+	{
+		return min <= p && p <= max;
+	}
+	float t0 = ( min - p ) / d;
+	float t1 = ( max - p ) / d;
+	if ( t0 > t1 )
+	{
+		std::swap( t0, t1 );
+	}
+	*tEnter = ae::Max( *tEnter, t0 );
+	*tExit = ae::Min( *tExit, t1 );
+	return *tEnter <= *tExit;
+}
+
+Level::RayHit Level::m_Raycast( const Ray& ray ) const
+{
+	RayHit result;
+	if ( !m_gridWidth )
+	{
+		return result;
+	}
+	
+	const ae::Vec2 p = ray.p0.GetXY();
+	const ae::Vec2 d = ( ray.p1 - ray.p0 ).GetXY();
+	float tEnter = 0.0f;
+	float tExit = 1.0f;
+	if ( !ClipRaySlab( p.x, d.x, m_gridMin.x, m_gridMin.x + m_gridWidth * m_gridCellSize, &tEnter, &tExit )
+		|| !ClipRaySlab( p.y, d.y, m_gridMin.y, m_gridMin.y + m_gridHeight * m_gridCellSize, &tEnter, &tExit ) )
+	{
+		return result;
+	}
+	
+	// Walk the cells touched by the ray in order (Amanatides and Woo)
+	const ae::Vec2 start = p + d * tEnter;
+	int32_t x = ae::Clip( (int32_t)floorf( ( start.x - m_gridMin.x ) / m_gridCellSize ), 0, m_gridWidth - 1 );
+	int32_t y = ae::Clip( (int32_t)floorf( ( start.y - m_gridMin.y ) / m_gridCellSize ), 0, m_gridHeight - 1 );
+	const int32_t stepX = ( d.x > 0.0f ) ? 1 : -1;
+	const int32_t stepY = ( d.y > 0.0f ) ? 1 : -1;
+	const float tDeltaX = ( d.x != 0.0f ) ? m_gridCellSize / fabsf( d.x ) : ae::MaxValue< float >();
+	const float tDeltaY = ( d.y != 0.0f ) ? m_gridCellSize / fabsf( d.y ) : ae::MaxValue< float >();
+	float tMaxX = ( d.x != 0.0f ) ? ( m_gridMin.x + ( x + ( stepX > 0 ? 1 : 0 ) ) * m_gridCellSize - p.x ) / d.x : ae::MaxValue< float >();
+	float tMaxY = ( d.y != 0.0f ) ? ( m_gridMin.y + ( y + ( stepY > 0 ? 1 : 0 ) ) * m_gridCellSize - p.y ) / d.y : ae::MaxValue< float >();
+	
+	float closestT = 1.0f;
+	const Line* closestLine = nullptr;
+	while ( true )
+	{
+		const uint32_t cell = y * m_gridWidth + x;
+		for ( uint32_t i = m_gridCellStart[ cell ]; i < m_gridCellStart[ cell + 1 ]; i++ )
+		{
+			const Line& l = m_collision[ m_gridLines[ i ] ];
+			const ae::Vec2 a = l.p0.GetXY();
+			const ae::Vec2 s = l.p1.GetXY() - a;
+			float denom = d.x * s.y - d.y * s.x;
+			if ( denom == 0.0f )
+			{
+				continue;
+			}
+			const ae::Vec2 ap = a - p;
+			float t = ( ap.x * s.y - ap.y * s.x ) / denom;
+			float u = ( ap.x * d.y - ap.y * d.x ) / denom;
+			if ( 0.0f <= t && t <= closestT && 0.0f <= u && u <= 1.0f )
+			{
+				closestT = t;
+				closestLine = &l;
+			}
+		}
+		
+		const float tNext = ae::Min( tMaxX, tMaxY );
+		if ( ( closestLine && closestT <= tNext ) || tNext > tExit )
+		{
+			break;
+		}
+		if ( tMaxX < tMaxY )
+		{
+			x += stepX;
+			tMaxX += tDeltaX;
+		}
+		else
+		{
+			y += stepY;
+			tMaxY += tDeltaY;
+		}
+		if ( x < 0 || x >= m_gridWidth || y < 0 || y >= m_gridHeight )
+		{
+			break;
+		}
+	}
+	
+	if ( closestLine )
+	{
+		ae::Vec3 normal = closestLine->GetNormal();
+		if ( normal.Dot( ray.p1 - ray.p0 ) > 0.0f )
+		{
+			normal = -normal;
+		}
+		result.hit = true;
+		result.t = closestT;
+		result.position = ray.p0 + ( ray.p1 - ray.p0 ) * closestT;
+		result.normal = normal;
+	}
+	return result;
 }
@@ -2,23 +2,54 @@
 #define ASTEROIDS_LEVEL_H
 
 #include "ae/aether.h"
-#include "Component.h"
+#include "ResourceManager.h"
 
 const ae::Tag TAG_LEVEL = "level";
 
-class Level : public Component
+// Intersects a triangle with a plane, the resulting segment keeps the triangle's winding in 2d
+bool TrianglePlaneIntersection( ae::Vec3 p, ae::Vec3 n, const ae::Vec3* t, ae::Vec3* outP0, ae::Vec3* outP1 );
+
+class Level
 {
 public:
-	void AddMesh( const class MeshResource* mesh, ae::Matrix4 localToWorld );
+	struct Ray
+	{
+		ae::Vec3 p0;
+		ae::Vec3 p1;
+	};
+	struct RayHit
+	{
+		bool hit = false;
+		float t = 1.0f; // Fraction of the way from p0 to p1
+		ae::Vec3 position = ae::Vec3( 0.0f );
+		ae::Vec3 normal = ae::Vec3( 0.0f );
+	};
+
+	// The level doesn't add a reference, the mesh must stay loaded while it is
+	// in use. Does nothing if the handle isn't loaded.
+	void AddMesh( ResourceManager* resources, MeshHandle mesh, ae::Matrix4 localToWorld );
+	// Re-slices the collision of every level mesh using the given resource
+	void RebuildMesh( ResourceManager* resources, MeshHandle mesh );
 	bool Test( class Transform* transform, class Physics* physics );
-	void Render( class Game* game );
+	// Sweeps a circle of the given radius from p0 to p1 and returns the time of
+	// first impact with the level in [0,1], along with the surface normal.
+	bool Sweep( ae::Vec3 p0, ae::Vec3 p1, float radius, float* tOut, ae::Vec3* normalOut ) const;
+	// Finds the first collision segment crossed by each ray. Large batches are
+	// split across the job system when one is provided.
+	void Raycast( const Ray* rays, RayHit* hitsOut, uint32_t count, class JobSystem* jobs = nullptr ) const;
+	// Adds draws for the level meshes to the state, using the state's frame uniforms for LOD selection
+	void Extract( class Game* game, struct RenderState* stateOut );
 	void Clear();
 	
 private:
 	struct LevelMesh
 	{
-		const MeshResource* mesh;
+		MeshHandle mesh;
 		ae::Matrix4 localToWorld;
+		// Range of m_collision sliced from this mesh
+		uint32_t collisionStart = 0;
+		uint32_t collisionCount = 0;
+		uint32_t lod = 0;
 	};
 	struct Line
 	{
@@ -26,8 +57,21 @@ private:
 		ae::Vec3 p0;
 		ae::Vec3 p1;
 	};
+	void m_Slice( const MeshResource* mesh, const LevelMesh& levelMesh, ae::Array< Line >* linesOut ) const;
+	void m_BuildGrid();
+	RayHit m_Raycast( const Ray& ray ) const;
+	
 	ae::Array< LevelMesh > m_levelMeshes = TAG_LEVEL;
 	ae::Array< Line > m_collision = TAG_LEVEL;
+	
+	// Uniform grid over m_collision in the xy plane. Lines for cell i are
+	// m_gridLines[ m_gridCellStart[ i ] ] to m_gridLines[ m_gridCellStart[ i + 1 ] ].
+	ae::Vec2 m_gridMin = ae::Vec2( 0.0f );
+	float m_gridCellSize = 1.0f;
+	int32_t m_gridWidth = 0;
+	int32_t m_gridHeight = 0;
+	ae::Array< uint32_t > m_gridCellStart = TAG_LEVEL;
+	ae::Array< uint32_t > m_gridLines = TAG_LEVEL;
 };
 
 #endif
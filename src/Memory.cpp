@@ -0,0 +1,278 @@
+#include "Memory.h"
+#include <cstdlib>
+#include <cstring>
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+static uintptr_t AlignUp( uintptr_t value, uint32_t alignment )
+{
+	return ( value + alignment - 1 ) & ~(uintptr_t)( alignment - 1 );
+}
+
+//------------------------------------------------------------------------------
+// GameAllocator member functions
+//------------------------------------------------------------------------------
+GameAllocator::GameAllocator( uint32_t frameArenaSize )
+{
+	m_startTime = ae::GetTime();
+	m_arenaSize = frameArenaSize;
+	m_arenas[ 0 ] = (uint8_t*)malloc( frameArenaSize );
+	m_arenas[ 1 ] = (uint8_t*)malloc( frameArenaSize );
+	m_tags[ kOverflowTag ].tag = "overflow";
+	m_frameTag = m_GetTagIndex( TAG_FRAME );
+}
+
+GameAllocator::~GameAllocator()
+{
+	free( m_arenas[ 0 ] );
+	free( m_arenas[ 1 ] );
+}
+
+void* GameAllocator::Allocate( ae::Tag tag, uint32_t bytes, uint32_t alignment )
+{
+	std::lock_guard< std::mutex > lock( m_lock );
+	uint32_t tagIndex = m_GetTagIndex( tag );
+	if ( tagIndex == m_frameTag )
+	{
+		if ( void* result = m_AllocateArena( tagIndex, bytes, alignment ) )
+		{
+			return result;
+		}
+	}
+	return m_AllocateHeap( tagIndex, bytes, alignment );
+}
+
+void* GameAllocator::Reallocate( void* data, uint32_t bytes, uint32_t alignment )
+{
+	std::lock_guard< std::mutex > lock( m_lock );
+	if ( !data )
+	{
+		return m_AllocateHeap( m_GetTagIndex( ae::Tag() ), bytes, alignment );
+	}
+	Header* header = m_GetHeader( data );
+	const uint32_t tagIndex = header->tag;
+	void* result = nullptr;
+	if ( header->arena )
+	{
+		result = m_AllocateArena( tagIndex, bytes, alignment );
+	}
+	if ( !result )
+	{
+		result = m_AllocateHeap( tagIndex, bytes, alignment );
+	}
+	memcpy( result, data, ae::Min( header->size, bytes ) );
+	if ( !header->arena )
+	{
+		m_TrackFree( tagIndex, header->size );
+		free( (uint8_t*)data - header->offset );
+	}
+	return result;
+}
+
+void GameAllocator::Free( void* data )
+{
+	if ( !data )
+	{
+		return;
+	}
+	Header* header = m_GetHeader( data );
+	if ( !header->arena )
+	{
+		// Arena allocations are released all at once by EndFrame()
+		std::lock_guard< std::mutex > lock( m_lock );
+		m_TrackFree( header->tag, header->size );
+		free( (uint8_t*)data - header->offset );
+	}
+}
+
+void GameAllocator::EndFrame()
+{
+	std::lock_guard< std::mutex > lock( m_lock );
+	m_currentArena = ( m_currentArena + 1 ) % 2;
+	m_arenaUsed = 0;
+
+	// The first frame includes everything allocated while loading
+	if ( m_frameCount )
+	{
+		m_peakFrameHeapAllocs = ae::Max( m_peakFrameHeapAllocs, m_frameHeapAllocs );
+	}
+	m_lastFrameHeapAllocs = m_frameHeapAllocs;
+	m_frameHeapAllocs = 0;
+	m_frameCount++;
+	
+	for ( uint32_t i = 0; i < m_tagCount; i++ )
+	{
+		m_tags[ i ].lastFrameCount = m_tags[ i ].frameCount;
+		m_tags[ i ].frameCount = 0;
+	}
+	m_tags[ kOverflowTag ].lastFrameCount = m_tags[ kOverflowTag ].frameCount;
+	m_tags[ kOverflowTag ].frameCount = 0;
+}
+
+void GameAllocator::LogStats() const
+{
+	std::lock_guard< std::mutex > lock( m_lock );
+	AE_INFO( "Frame arena high water: # / # bytes", m_arenaHighWater, m_arenaSize );
+	AE_INFO( "Heap allocations per frame: # (last) # (peak)", m_lastFrameHeapAllocs, m_peakFrameHeapAllocs );
+	const double elapsed = ae::Max( ae::GetTime() - m_startTime, 0.001 );
+	for ( uint32_t i = 0; i <= kOverflowTag; i++ )
+	{
+		const TagStats& stats = m_tags[ i ];
+		if ( i >= m_tagCount && ( i != kOverflowTag || !stats.totalCount ) )
+		{
+			continue;
+		}
+		AE_INFO( "Tag '#' live: # bytes (# allocs) peak: # bytes total: # allocs (#/s) last frame: # allocs budget: #",
+			stats.tag.c_str(),
+			stats.liveBytes,
+			stats.liveCount,
+			stats.peakBytes,
+			stats.totalCount,
+			(uint32_t)( stats.totalCount / elapsed ),
+			stats.lastFrameCount,
+			stats.budget
+		);
+	}
+}
+
+void GameAllocator::SetBudget( ae::Tag tag, uint64_t bytes )
+{
+	std::lock_guard< std::mutex > lock( m_lock );
+	TagStats& stats = m_tags[ m_GetTagIndex( tag ) ];
+	stats.budget = bytes;
+	stats.overBudget = false;
+}
+
+uint64_t GameAllocator::GetHeapAllocations() const
+{
+	std::lock_guard< std::mutex > lock( m_lock );
+	return m_heapAllocs;
+}
+
+bool GameAllocator::GetTagStats( ae::Tag tag, TagStats* statsOut ) const
+{
+	std::lock_guard< std::mutex > lock( m_lock );
+	for ( uint32_t i = 0; i < m_tagCount; i++ )
+	{
+		if ( m_tags[ i ].tag == tag )
+		{
+			*statsOut = m_tags[ i ];
+			return true;
+		}
+	}
+	return false;
+}
+
+GameAllocator::Header* GameAllocator::m_GetHeader( void* data )
+{
+	return (Header*)( (uint8_t*)data - sizeof(Header) );
+}
+
+void* GameAllocator::m_AllocateHeap( uint32_t tag, uint32_t bytes, uint32_t alignment )
+{
+	alignment = ae::Max( alignment, (uint32_t)alignof(Header) );
+	uint8_t* block = (uint8_t*)malloc( bytes + alignment + sizeof(Header) );
+	if ( !block )
+	{
+		return nullptr;
+	}
+	uint8_t* result = (uint8_t*)AlignUp( (uintptr_t)( block + sizeof(Header) ), alignment );
+	Header* header = m_GetHeader( result );
+	header->size = bytes;
+	header->offset = (uint32_t)( result - block );
+	header->arena = 0;
+	header->tag = tag;
+	m_frameHeapAllocs++;
+	m_heapAllocs++;
+	m_TrackAlloc( tag, bytes, true );
+	return result;
+}
+
+void* GameAllocator::m_AllocateArena( uint32_t tag, uint32_t bytes, uint32_t alignment )
+{
+	alignment = ae::Max( alignment, (uint32_t)alignof(Header) );
+	uint8_t* arena = m_arenas[ m_currentArena ];
+	uintptr_t start = (uintptr_t)( arena + m_arenaUsed );
+	uintptr_t result = AlignUp( start + sizeof(Header), alignment );
+	uint32_t end = (uint32_t)( result - (uintptr_t)arena ) + bytes;
+	if ( end > m_arenaSize )
+	{
+		if ( !m_arenaOverflowWarned )
+		{
+			AE_WARN( "Frame arena exhausted (# bytes), falling back to the heap", m_arenaSize );
+			m_arenaOverflowWarned = true;
+		}
+		return nullptr;
+	}
+	Header* header = m_GetHeader( (void*)result );
+	header->size = bytes;
+	header->offset = (uint32_t)( result - start );
+	header->arena = m_currentArena + 1;
+	header->tag = tag;
+	m_arenaUsed = end;
+	m_arenaHighWater = ae::Max( m_arenaHighWater, m_arenaUsed );
+	m_TrackAlloc( tag, bytes, false );
+	return (void*)result;
+}
+
+uint32_t GameAllocator::m_GetTagIndex( const ae::Tag& tag )
+{
+	for ( uint32_t i = 0; i < m_tagCount; i++ )
+	{
+		if ( m_tags[ i ].tag == tag )
+		{
+			return i;
+		}
+	}
+	if ( m_tagCount < kMaxTags )
+	{
+		m_tags[ m_tagCount ].tag = tag;
+		return m_tagCount++;
+	}
+	if ( !m_tagOverflowWarned )
+	{
+		AE_WARN( "More than # allocation tags, '#' and any later tags are tracked as 'overflow'", kMaxTags, tag.c_str() );
+		m_tagOverflowWarned = true;
+	}
+	return kOverflowTag;
+}
+
+void GameAllocator::m_TrackAlloc( uint32_t tag, uint32_t bytes, bool heap )
+{
+	TagStats& stats = m_tags[ tag ];
+	stats.totalCount++;
+	stats.frameCount++;
+	if ( !heap )
+	{
+		// Arena memory is reclaimed in bulk, so only the allocation rate is meaningful
+		return;
+	}
+	stats.liveBytes += bytes;
+	stats.liveCount++;
+	stats.peakBytes = ae::Max( stats.peakBytes, stats.liveBytes );
+	if ( stats.budget && !stats.overBudget && stats.liveBytes > stats.budget )
+	{
+		AE_WARN( "Tag '#' is over budget: # / # bytes", stats.tag.c_str(), stats.liveBytes, stats.budget );
+		stats.overBudget = true;
+	}
+}
+
+void GameAllocator::m_TrackFree( uint32_t tag, uint32_t bytes )
+{
+	TagStats& stats = m_tags[ tag ];
+	AE_ASSERT( stats.liveBytes >= bytes && stats.liveCount );
+	stats.liveBytes -= bytes;
+	stats.liveCount--;
+	if ( stats.overBudget && stats.liveBytes <= stats.budget )
+	{
+		stats.overBudget = false;
+	}
+}
+
+GameAllocator& GetGameAllocator()
+{
+	// Intentionally never destroyed, static objects may free memory after main() returns
+	static GameAllocator* s_allocator = new GameAllocator( 1024 * 1024 );
+	return *s_allocator;
+}
@@ -0,0 +1,100 @@
+#ifndef ASTEROIDS_MEMORY_H
+#define ASTEROIDS_MEMORY_H
+
+#include "ae/aether.h"
+#include <mutex>
+
+// Allocations with this tag are only valid until the end of the following frame
+const ae::Tag TAG_FRAME = "frame";
+
+//------------------------------------------------------------------------------
+// GameAllocator class
+//------------------------------------------------------------------------------
+// Global allocator for the game. TAG_FRAME allocations are bump allocated from
+// one of two linear arenas, everything else goes to the heap. The arenas are
+// swapped and reset in EndFrame(), so transient data written during frame N
+// stays valid while frame N+1 is consuming it. Live bytes, peak bytes and
+// allocation counts are tracked for each ae::Tag.
+class GameAllocator : public ae::Allocator
+{
+public:
+	GameAllocator( uint32_t frameArenaSize );
+	~GameAllocator();
+
+	void* Allocate( ae::Tag tag, uint32_t bytes, uint32_t alignment ) override;
+	void* Reallocate( void* data, uint32_t bytes, uint32_t alignment ) override;
+	void Free( void* data ) override;
+	bool IsThreadSafe() const override { return true; }
+
+	// Resets the older of the two frame arenas in O(1)
+	void EndFrame();
+	void LogStats() const;
+	
+	// Warns when live heap memory for the given tag goes over budget, 0 disables
+	void SetBudget( ae::Tag tag, uint64_t bytes );
+	
+	struct TagStats
+	{
+		ae::Tag tag;
+		uint64_t liveBytes = 0;
+		uint64_t peakBytes = 0;
+		uint32_t liveCount = 0;
+		uint64_t totalCount = 0;
+		uint32_t frameCount = 0;
+		uint32_t lastFrameCount = 0;
+		uint64_t budget = 0;
+		bool overBudget = false;
+	};
+	// Returns false if the tag has never allocated
+	bool GetTagStats( ae::Tag tag, TagStats* statsOut ) const;
+
+	uint32_t GetFrameArenaSize() const { return m_arenaSize; }
+	uint32_t GetFrameArenaHighWater() const { return m_arenaHighWater; }
+	uint32_t GetLastFrameHeapAllocations() const { return m_lastFrameHeapAllocs; }
+	uint32_t GetPeakFrameHeapAllocations() const { return m_peakFrameHeapAllocs; }
+	// Heap allocations since startup, for counting allocations across a block of code
+	uint64_t GetHeapAllocations() const;
+
+private:
+	struct Header
+	{
+		uint32_t size;
+		uint32_t offset; // Distance from the start of the underlying block
+		uint32_t arena; // Arena index + 1, or 0 for heap allocations
+		uint32_t tag; // Index into m_tags
+	};
+	static Header* m_GetHeader( void* data );
+	void* m_AllocateHeap( uint32_t tag, uint32_t bytes, uint32_t alignment );
+	void* m_AllocateArena( uint32_t tag, uint32_t bytes, uint32_t alignment );
+	uint32_t m_GetTagIndex( const ae::Tag& tag );
+	void m_TrackAlloc( uint32_t tag, uint32_t bytes, bool heap );
+	void m_TrackFree( uint32_t tag, uint32_t bytes );
+
+	mutable std::mutex m_lock;
+	uint8_t* m_arenas[ 2 ] = { nullptr, nullptr };
+	uint32_t m_arenaSize = 0;
+	uint32_t m_arenaUsed = 0;
+	uint32_t m_currentArena = 0;
+	uint32_t m_arenaHighWater = 0;
+	bool m_arenaOverflowWarned = false;
+
+	// Fixed size so that tracking never allocates. Tags after the first kMaxTags
+	// are all tracked in the extra overflow entry at the end.
+	static const uint32_t kMaxTags = 32;
+	static const uint32_t kOverflowTag = kMaxTags;
+	TagStats m_tags[ kMaxTags + 1 ];
+	uint32_t m_tagCount = 0;
+	bool m_tagOverflowWarned = false;
+	uint32_t m_frameTag = 0; // Index of TAG_FRAME, so Allocate() doesn't compare strings
+	double m_startTime = 0.0;
+
+	uint32_t m_frameCount = 0;
+	uint32_t m_frameHeapAllocs = 0;
+	uint64_t m_heapAllocs = 0;
+	uint32_t m_lastFrameHeapAllocs = 0;
+	uint32_t m_peakFrameHeapAllocs = 0;
+};
+
+GameAllocator& GetGameAllocator();
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef ASTEROIDS_RENDERSTATE_H
+#define ASTEROIDS_RENDERSTATE_H
+
+#include "ae/aether.h"
+#include "Resources.h"
+
+const ae::Tag TAG_RENDER = "render";
+
+//------------------------------------------------------------------------------
+// RenderState
+//------------------------------------------------------------------------------
+// Everything needed to draw one simulation tick, extracted from the registry at
+// the end of the tick. Game keeps two of these so the simulation can write the
+// next tick while the main thread draws the previous one without either side
+// touching the other's data.
+struct RenderState
+{
+	struct Draw
+	{
+		ae::Matrix4 transform;
+		const MeshResource* mesh;
+		const ae::Shader* shader;
+		ae::Vec3 color; // Linear
+		uint32_t lod;
+	};
+	
+	FrameUniforms frame;
+	// ae::GetTime() when the input used by the tick was sampled
+	double inputTime = 0.0;
+	ae::Array< Draw > draws = TAG_RENDER;
+	// Debug drawing from the tick, see GetDebugLines()
+	ae::DebugLines debugLines;
+};
+
+#endif
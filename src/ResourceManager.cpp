@@ -0,0 +1,335 @@
+#include "ResourceManager.h"
+
+// Frames an unreferenced mesh must go unused before it can be evicted, covers
+// the render state drawn one frame behind the simulation
+const uint64_t kEvictionDelayFrames = 2;
+
+//------------------------------------------------------------------------------
+// ResourceManager member functions
+//------------------------------------------------------------------------------
+void ResourceManager::Initialize( ae::FileSystem* file, uint64_t budgetBytes, bool upload )
+{
+	m_file = file;
+	m_budget = budgetBytes;
+	m_upload = upload;
+}
+
+void ResourceManager::Terminate()
+{
+	for ( uint32_t i = 0; i < m_meshes.Length(); i++ )
+	{
+		MeshSlot* slot = m_meshes[ i ];
+		if ( slot->loaded && slot->refCount )
+		{
+			AE_WARN( "Mesh '#' still has # references", slot->path, slot->refCount );
+		}
+		m_FreeMesh( i );
+		ae::Delete( slot );
+	}
+	m_meshes.Clear();
+	for ( ShaderSlot* slot : m_shaders )
+	{
+		if ( slot->loaded )
+		{
+			slot->shader.Terminate();
+		}
+		ae::Delete( slot );
+	}
+	m_shaders.Clear();
+}
+
+MeshHandle ResourceManager::LoadMesh( const char* path )
+{
+	MeshHandle handle = FindMesh( path );
+	if ( handle.IsValid() )
+	{
+		AddRef( handle );
+		m_cacheHitCount++;
+		return handle;
+	}
+	ae::Array< Vertex > vertices = TAG_RESOURCE;
+	ae::Array< uint16_t > indices = TAG_RESOURCE;
+	if ( !MeshResource::Load( m_file, path, &vertices, &indices ) )
+	{
+		return MeshHandle();
+	}
+	MeshSlot* slot = m_AllocateMesh( path, &handle );
+	slot->mesh.Initialize( &vertices, &indices, m_upload );
+	m_loadCount++;
+	return handle;
+}
+
+MeshHandle ResourceManager::CreateMesh( const char* name, const Vertex* vertices, const uint16_t* indices, uint32_t vertexCount, uint32_t indexCount )
+{
+	ae::Array< Vertex > vertexArray = TAG_RESOURCE;
+	ae::Array< uint16_t > indexArray = TAG_RESOURCE;
+	vertexArray.Append( vertices, vertexCount );
+	indexArray.Append( indices, indexCount );
+	return CreateMesh( name, &vertexArray, &indexArray );
+}
+
+MeshHandle ResourceManager::CreateMesh( const char* name, ae::Array< Vertex >* vertices, ae::Array< uint16_t >* indices )
+{
+	AE_ASSERT_MSG( !FindMesh( name ).IsValid(), "Mesh '#' already exists", name );
+	MeshHandle handle;
+	MeshSlot* slot = m_AllocateMesh( name, &handle );
+	slot->mesh.Initialize( vertices, indices, m_upload );
+	return handle;
+}
+
+ShaderHandle ResourceManager::LoadShader( const char* name, const char* vertShader, const char* fragShader )
+{
+	uint32_t freeIndex = m_shaders.Length();
+	for ( uint32_t i = 0; i < m_shaders.Length(); i++ )
+	{
+		ShaderSlot* slot = m_shaders[ i ];
+		if ( slot->loaded && slot->name == name )
+		{
+			slot->refCount++;
+			m_cacheHitCount++;
+			return { i, slot->generation };
+		}
+		else if ( !slot->loaded && freeIndex == m_shaders.Length() )
+		{
+			freeIndex = i;
+		}
+	}
+	if ( freeIndex == m_shaders.Length() )
+	{
+		m_shaders.Append( ae::New< ShaderSlot >( TAG_RESOURCE ) );
+	}
+	ShaderSlot* slot = m_shaders[ freeIndex ];
+	slot->name = name;
+	slot->refCount = 1;
+	slot->loaded = true;
+	if ( m_upload )
+	{
+		slot->shader.Initialize( vertShader, fragShader, nullptr, 0 );
+		slot->shader.SetDepthTest( true );
+		slot->shader.SetDepthWrite( true );
+	}
+	m_loadCount++;
+	return { freeIndex, slot->generation };
+}
+
+MeshHandle ResourceManager::FindMesh( const char* path ) const
+{
+	for ( uint32_t i = 0; i < m_meshes.Length(); i++ )
+	{
+		const MeshSlot* slot = m_meshes[ i ];
+		if ( slot->loaded && slot->path == path )
+		{
+			return { i, slot->generation };
+		}
+	}
+	return MeshHandle();
+}
+
+void ResourceManager::AddRef( MeshHandle handle )
+{
+	MeshSlot* slot = m_GetSlot( handle );
+	AE_ASSERT_MSG( slot, "Invalid mesh handle" );
+	slot->refCount++;
+}
+
+void ResourceManager::AddRef( ShaderHandle handle )
+{
+	ShaderSlot* slot = m_GetSlot( handle );
+	AE_ASSERT_MSG( slot, "Invalid shader handle" );
+	slot->refCount++;
+}
+
+void ResourceManager::Release( MeshHandle handle )
+{
+	// Unreferenced meshes stay cached until they need to be evicted
+	if ( !handle.IsValid() )
+	{
+		return;
+	}
+	MeshSlot* slot = m_GetSlot( handle );
+	AE_ASSERT_MSG( slot && slot->refCount, "Mesh released too many times" );
+	slot->refCount--;
+}
+
+void ResourceManager::Release( ShaderHandle handle )
+{
+	// Shaders are small, so they are freed as soon as they are unreferenced
+	if ( !handle.IsValid() )
+	{
+		return;
+	}
+	ShaderSlot* slot = m_GetSlot( handle );
+	AE_ASSERT_MSG( slot && slot->refCount, "Shader released too many times" );
+	slot->refCount--;
+	if ( !slot->refCount )
+	{
+		if ( m_upload )
+		{
+			slot->shader.Terminate();
+		}
+		slot->loaded = false;
+		slot->generation++;
+	}
+}
+
+MeshResource* ResourceManager::Get( MeshHandle handle )
+{
+	if ( MeshSlot* slot = m_GetSlot( handle ) )
+	{
+		slot->lastUsedFrame = m_frame;
+		return &slot->mesh;
+	}
+	return nullptr;
+}
+
+const ae::Shader* ResourceManager::Get( ShaderHandle handle ) const
+{
+	const ShaderSlot* slot = m_GetSlot( handle );
+	return slot ? &slot->shader : nullptr;
+}
+
+const char* ResourceManager::GetPath( MeshHandle handle ) const
+{
+	const MeshSlot* slot = m_GetSlot( handle );
+	return slot ? slot->path.c_str() : "";
+}
+
+void ResourceManager::EndFrame()
+{
+	m_frame++;
+	uint64_t bytes = GetMeshBytes();
+	while ( m_budget && bytes > m_budget )
+	{
+		uint32_t oldest = m_meshes.Length();
+		for ( uint32_t i = 0; i < m_meshes.Length(); i++ )
+		{
+			const MeshSlot* slot = m_meshes[ i ];
+			if ( !slot->loaded || slot->refCount || slot->lastUsedFrame + kEvictionDelayFrames > m_frame )
+			{
+				continue;
+			}
+			if ( oldest == m_meshes.Length() || slot->lastUsedFrame < m_meshes[ oldest ]->lastUsedFrame )
+			{
+				oldest = i;
+			}
+		}
+		if ( oldest == m_meshes.Length() )
+		{
+			if ( !m_overBudgetWarned )
+			{
+				AE_WARN( "Meshes are over budget with nothing to evict: # / # bytes", bytes, m_budget );
+				m_overBudgetWarned = true;
+			}
+			return;
+		}
+		bytes -= m_meshes[ oldest ]->mesh.GetMemoryBytes();
+		AE_INFO( "Evicting mesh '#'", m_meshes[ oldest ]->path );
+		m_FreeMesh( oldest );
+		m_evictionCount++;
+	}
+	m_overBudgetWarned = false;
+}
+
+uint64_t ResourceManager::GetMeshBytes() const
+{
+	uint64_t bytes = 0;
+	for ( const MeshSlot* slot : m_meshes )
+	{
+		if ( slot->loaded )
+		{
+			bytes += slot->mesh.GetMemoryBytes();
+		}
+	}
+	return bytes;
+}
+
+uint32_t ResourceManager::GetMeshCount() const
+{
+	uint32_t count = 0;
+	for ( const MeshSlot* slot : m_meshes )
+	{
+		count += slot->loaded ? 1 : 0;
+	}
+	return count;
+}
+
+void ResourceManager::LogStats() const
+{
+	AE_INFO( "Resources: # meshes # / # bytes, # loads # cache hits # evictions",
+		GetMeshCount(),
+		GetMeshBytes(),
+		m_budget,
+		m_loadCount,
+		m_cacheHitCount,
+		m_evictionCount
+	);
+	for ( const MeshSlot* slot : m_meshes )
+	{
+		if ( slot->loaded )
+		{
+			AE_INFO( "Mesh '#' refs: # bytes: # last used: # frames ago", slot->path, slot->refCount, slot->mesh.GetMemoryBytes(), m_frame - slot->lastUsedFrame );
+		}
+	}
+}
+
+ResourceManager::MeshSlot* ResourceManager::m_GetSlot( MeshHandle handle ) const
+{
+	if ( handle.index < m_meshes.Length() )
+	{
+		MeshSlot* slot = m_meshes[ handle.index ];
+		if ( slot->loaded && slot->generation == handle.generation )
+		{
+			return slot;
+		}
+	}
+	return nullptr;
+}
+
+ResourceManager::ShaderSlot* ResourceManager::m_GetSlot( ShaderHandle handle ) const
+{
+	if ( handle.index < m_shaders.Length() )
+	{
+		ShaderSlot* slot = m_shaders[ handle.index ];
+		if ( slot->loaded && slot->generation == handle.generation )
+		{
+			return slot;
+		}
+	}
+	return nullptr;
+}
+
+ResourceManager::MeshSlot* ResourceManager::m_AllocateMesh( const char* path, MeshHandle* handleOut )
+{
+	uint32_t index = m_meshes.Length();
+	for ( uint32_t i = 0; i < m_meshes.Length(); i++ )
+	{
+		if ( !m_meshes[ i ]->loaded )
+		{
+			index = i;
+			break;
+		}
+	}
+	if ( index == m_meshes.Length() )
+	{
+		m_meshes.Append( ae::New< MeshSlot >( TAG_RESOURCE ) );
+	}
+	MeshSlot* slot = m_meshes[ index ];
+	slot->path = path;
+	slot->refCount = 1;
+	slot->lastUsedFrame = m_frame;
+	slot->loaded = true;
+	handleOut->index = index;
+	handleOut->generation = slot->generation;
+	return slot;
+}
+
+void ResourceManager::m_FreeMesh( uint32_t index )
+{
+	MeshSlot* slot = m_meshes[ index ];
+	if ( slot->loaded )
+	{
+		slot->mesh.Terminate();
+		slot->loaded = false;
+		slot->generation++;
+	}
+}
@@ -0,0 +1,114 @@
+#ifndef ASTEROIDS_RESOURCEMANAGER_H
+#define ASTEROIDS_RESOURCEMANAGER_H
+
+#include "ae/aether.h"
+#include "Resources.h"
+
+//------------------------------------------------------------------------------
+// Handle
+//------------------------------------------------------------------------------
+// Refers to a resource by slot index and generation. A handle stays safe to
+// hold after its resource is evicted, ResourceManager::Get() just returns null.
+template< typename T >
+struct Handle
+{
+	bool IsValid() const { return generation != 0; }
+	bool operator==( Handle other ) const { return index == other.index && generation == other.generation; }
+	bool operator!=( Handle other ) const { return !( *this == other ); }
+	// Only used to group draws that share a resource
+	bool operator<( Handle other ) const { return ( index != other.index ) ? ( index < other.index ) : ( generation < other.generation ); }
+
+	uint32_t index = 0;
+	uint32_t generation = 0; // 0 is never used by a live resource
+};
+using MeshHandle = Handle< MeshResource >;
+using ShaderHandle = Handle< ae::Shader >;
+
+//------------------------------------------------------------------------------
+// ResourceManager class
+//------------------------------------------------------------------------------
+// Owns every mesh and shader. Requests for a path that is already loaded return
+// the existing resource. Each Load*() and AddRef() must be matched by a
+// Release(). Unreferenced meshes stay cached until the total mesh memory goes
+// over budget, then the least recently drawn ones are evicted in EndFrame().
+// Not thread safe, Get() may be called from the simulation thread while the
+// main thread isn't using the manager.
+class ResourceManager
+{
+public:
+	// Meshes are kept on the CPU only when upload is false, for tools that have
+	// no graphics device
+	void Initialize( ae::FileSystem* file, uint64_t budgetBytes, bool upload = true );
+	void Terminate();
+
+	// Returns an invalid handle if the file couldn't be loaded
+	MeshHandle LoadMesh( const char* path );
+	// Registers a mesh built in code under the given name. The array overload
+	// takes the contents of the arrays.
+	MeshHandle CreateMesh( const char* name, const Vertex* vertices, const uint16_t* indices, uint32_t vertexCount, uint32_t indexCount );
+	MeshHandle CreateMesh( const char* name, ae::Array< Vertex >* vertices, ae::Array< uint16_t >* indices );
+	ShaderHandle LoadShader( const char* name, const char* vertShader, const char* fragShader );
+	// Returns the loaded mesh with the given path or name without adding a reference
+	MeshHandle FindMesh( const char* path ) const;
+
+	void AddRef( MeshHandle handle );
+	void AddRef( ShaderHandle handle );
+	// Releasing an invalid handle does nothing
+	void Release( MeshHandle handle );
+	void Release( ShaderHandle handle );
+
+	// Null for invalid or evicted handles. Getting a mesh marks it as used this frame.
+	MeshResource* Get( MeshHandle handle );
+	const ae::Shader* Get( ShaderHandle handle ) const;
+	const char* GetPath( MeshHandle handle ) const;
+
+	// Evicts unreferenced meshes, least recently used first, until under budget.
+	// Meshes used in the last couple of frames are kept because a pipelined
+	// render state may still point at them.
+	void EndFrame();
+	void SetBudget( uint64_t bytes ) { m_budget = bytes; }
+	uint64_t GetBudget() const { return m_budget; }
+	uint64_t GetMeshBytes() const;
+	uint32_t GetMeshCount() const;
+	void LogStats() const;
+
+private:
+	// Slots are never freed so resource pointers stay stable, a slot's generation
+	// is bumped every time its resource is freed
+	struct MeshSlot
+	{
+		MeshResource mesh;
+		ae::Str256 path;
+		uint32_t generation = 1;
+		uint32_t refCount = 0;
+		uint64_t lastUsedFrame = 0;
+		bool loaded = false;
+	};
+	struct ShaderSlot
+	{
+		ae::Shader shader;
+		ae::Str256 name;
+		uint32_t generation = 1;
+		uint32_t refCount = 0;
+		bool loaded = false;
+	};
+	MeshSlot* m_GetSlot( MeshHandle handle ) const;
+	ShaderSlot* m_GetSlot( ShaderHandle handle ) const;
+	MeshSlot* m_AllocateMesh( const char* path, MeshHandle* handleOut );
+	void m_FreeMesh( uint32_t index );
+
+	ae::FileSystem* m_file = nullptr;
+	bool m_upload = true;
+	uint64_t m_budget = 0;
+	uint64_t m_frame = 0;
+	bool m_overBudgetWarned = false;
+	ae::Array< MeshSlot* > m_meshes = TAG_RESOURCE;
+	ae::Array< ShaderSlot* > m_shaders = TAG_RESOURCE;
+
+	// Stats
+	uint32_t m_loadCount = 0;
+	uint32_t m_cacheHitCount = 0;
+	uint32_t m_evictionCount = 0;
+};
+
+#endif
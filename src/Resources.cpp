@@ -1,6 +1,8 @@
 #include "Resources.h"
 #include "Game.h"
+#include "Simplify.h"
 #include "ofbx.h"
+#include <cstring>
 
 //------------------------------------------------------------------------------
 // Helpers
@@ -15,6 +17,12 @@ ae::Matrix4 ofbxToAe( const ofbx::Matrix& m )
 	return result;
 }
 
+// Meshes with fewer triangles than this are always drawn at full detail
+const uint32_t kMinLodTriangles = 64;
+// Projected radius in NDC below which each LOD is used
+const float kLodRadius[ MeshResource::kMaxLods ] = { 0.0f, 0.08f, 0.04f, 0.02f };
+const float kLodHysteresis = 1.25f;
+
 //------------------------------------------------------------------------------
 // Shaders
 //------------------------------------------------------------------------------
@@ -46,6 +54,29 @@ const char* kFragShader = "\
 		AE_COLOR = vec4(u_color * v_color.rgb * light, 1.0);\
 	}";
 
+//------------------------------------------------------------------------------
+// Uniforms
+//------------------------------------------------------------------------------
+const char* kUniformNames[] =
+{
+	"u_modelToNdc",
+	"u_normalMatrix",
+	"u_ambientLight",
+	"u_color",
+};
+static_assert( sizeof(kUniformNames) / sizeof(*kUniformNames) == (uint32_t)UniformId::Count, "Missing uniform names" );
+
+float GetProjectedRadius( const ae::Matrix4& worldToNdc, ae::Vec3 center, float radius )
+{
+	ae::Vec4 c = worldToNdc * ae::Vec4( center, 1.0f );
+	ae::Vec4 e = worldToNdc * ae::Vec4( center + ae::Vec3( radius, 0.0f, 0.0f ), 1.0f );
+	if ( c.w <= 0.0f || e.w <= 0.0f )
+	{
+		return 0.0f;
+	}
+	return ( e.GetXY() / e.w - c.GetXY() / c.w ).Length();
+}
+
 //------------------------------------------------------------------------------
 // Ship
 //------------------------------------------------------------------------------
@@ -76,20 +107,236 @@ const uint16_t kAsteroidIndices[] =
 	0, 2, 3,
 };
 
+//------------------------------------------------------------------------------
+// UniformLayout member functions
+//------------------------------------------------------------------------------
+void UniformLayout::Initialize( const char* vertShader, const char* fragShader )
+{
+	m_objectBytes = 0;
+	for ( uint32_t i = 0; i < (uint32_t)UniformId::Count; i++ )
+	{
+		const char* name = kUniformNames[ i ];
+		m_used[ i ] = strstr( vertShader, name ) || strstr( fragShader, name );
+	}
+	if ( m_used[ (uint32_t)UniformId::ModelToNdc ] )
+	{
+		m_objectBytes += sizeof(ObjectUniforms::modelToNdc);
+	}
+	if ( m_used[ (uint32_t)UniformId::NormalMatrix ] )
+	{
+		m_objectBytes += sizeof(ObjectUniforms::normalMatrix);
+	}
+	if ( m_used[ (uint32_t)UniformId::Color ] )
+	{
+		m_objectBytes += sizeof(ObjectUniforms::color);
+	}
+}
+
+void UniformLayout::BeginFrame( const FrameUniforms& frame )
+{
+	m_frame = frame;
+	m_uniforms = ae::UniformList();
+	m_frameBytes = 0;
+	m_uploadBytes = 0;
+	if ( m_used[ (uint32_t)UniformId::AmbientLight ] )
+	{
+		m_uniforms.Set( kUniformNames[ (uint32_t)UniformId::AmbientLight ], frame.ambientLight );
+		m_frameBytes += sizeof(frame.ambientLight);
+	}
+}
+
+const ae::UniformList& UniformLayout::Set( const ObjectUniforms& object )
+{
+	// Frame uniforms set in BeginFrame() stay in the list, object uniforms are
+	// overwritten in place
+	if ( m_used[ (uint32_t)UniformId::ModelToNdc ] )
+	{
+		m_uniforms.Set( kUniformNames[ (uint32_t)UniformId::ModelToNdc ], object.modelToNdc );
+	}
+	if ( m_used[ (uint32_t)UniformId::NormalMatrix ] )
+	{
+		m_uniforms.Set( kUniformNames[ (uint32_t)UniformId::NormalMatrix ], object.normalMatrix );
+	}
+	if ( m_used[ (uint32_t)UniformId::Color ] )
+	{
+		m_uniforms.Set( kUniformNames[ (uint32_t)UniformId::Color ], object.color );
+	}
+	m_uploadBytes += m_frameBytes + m_objectBytes;
+	return m_uniforms;
+}
+
 //------------------------------------------------------------------------------
 // MeshResource member functions
 //------------------------------------------------------------------------------
 void MeshResource::Initialize( const Vertex* vertices, const uint16_t* indices, uint32_t vertexCount, uint32_t indexCount )
 {
-	vertexData.Initialize( sizeof(*vertices), sizeof(*indices), vertexCount, indexCount, ae::VertexData::Primitive::Triangle, ae::VertexData::Usage::Static, ae::VertexData::Usage::Static );
-	vertexData.AddAttribute( "a_position", 4, ae::VertexData::Type::Float, offsetof( Vertex, pos ) );
-	vertexData.AddAttribute( "a_normal", 4, ae::VertexData::Type::Float, offsetof( Vertex, normal ) );
-	vertexData.AddAttribute( "a_color", 4, ae::VertexData::Type::Float, offsetof( Vertex, color ) );
-	vertexData.SetVertices( vertices, vertexCount );
-	vertexData.SetIndices( indices, indexCount );
+	this->vertices.Clear();
+	this->indices.Clear();
+	this->vertices.Append( vertices, vertexCount );
+	this->indices.Append( indices, indexCount );
+	m_Upload( true );
 }
 
 void MeshResource::Initialize( ae::FileSystem* file, const char* filePath )
+{
+	m_filePath = filePath;
+	vertices.Clear();
+	indices.Clear();
+	if ( Load( file, filePath, &vertices, &indices ) )
+	{
+		m_Upload( true );
+	}
+}
+
+void MeshResource::Initialize( ae::Array< Vertex >* vertices, ae::Array< uint16_t >* indices, bool upload )
+{
+	std::swap( this->vertices, *vertices );
+	std::swap( this->indices, *indices );
+	m_Upload( upload );
+}
+
+void MeshResource::Terminate()
+{
+	if ( m_uploaded )
+	{
+		vertexData.Terminate();
+		for ( uint32_t i = 1; i < m_lodCount; i++ )
+		{
+			m_lodVertexData[ i - 1 ].Terminate();
+		}
+		m_lodCount = 0;
+		m_gpuBytes = 0;
+		m_uploaded = false;
+	}
+	// Swapped with empty arrays so the memory is actually released
+	ae::Array< Vertex > emptyVertices = TAG_RESOURCE;
+	ae::Array< uint16_t > emptyIndices = TAG_RESOURCE;
+	std::swap( vertices, emptyVertices );
+	std::swap( indices, emptyIndices );
+}
+
+const ae::VertexData& MeshResource::GetVertexData( uint32_t lod ) const
+{
+	AE_ASSERT( lod < ae::Max( m_lodCount, 1u ) );
+	return lod ? m_lodVertexData[ lod - 1 ] : vertexData;
+}
+
+uint32_t MeshResource::GetTriangleCount( uint32_t lod ) const
+{
+	return ( lod < m_lodCount ) ? m_lodTriangleCounts[ lod ] : 0;
+}
+
+uint32_t MeshResource::SelectLod( float projectedRadius, uint32_t currentLod ) const
+{
+	if ( m_lodCount <= 1 )
+	{
+		return 0;
+	}
+	uint32_t lod = ae::Min( currentLod, m_lodCount - 1 );
+	while ( lod + 1 < m_lodCount && projectedRadius < kLodRadius[ lod + 1 ] )
+	{
+		lod++;
+	}
+	while ( lod > 0 && projectedRadius > kLodRadius[ lod ] * kLodHysteresis )
+	{
+		lod--;
+	}
+	return lod;
+}
+
+uint32_t MeshResource::GetMemoryBytes() const
+{
+	return vertices.Size() * sizeof(Vertex) + indices.Size() * sizeof(uint16_t) + m_gpuBytes;
+}
+
+void MeshResource::m_Upload( bool upload )
+{
+	if ( m_uploaded )
+	{
+		vertexData.Terminate();
+		for ( uint32_t i = 1; i < m_lodCount; i++ )
+		{
+			m_lodVertexData[ i - 1 ].Terminate();
+		}
+		m_uploaded = false;
+	}
+	m_lodTriangleCounts[ 0 ] = indices.Length() / 3;
+	m_lodCount = 1;
+	m_gpuBytes = 0;
+	m_radius = 0.0f;
+	for ( const Vertex& v : vertices )
+	{
+		m_radius = ae::Max( m_radius, v.pos.GetXYZ().Length() );
+	}
+	if ( !upload )
+	{
+		return;
+	}
+	m_gpuBytes = m_InitializeVertexData( &vertexData, vertices.Begin(), vertices.Length(), indices.Begin(), indices.Length() );
+	m_GenerateLods();
+	m_uploaded = true;
+}
+
+void MeshResource::m_GenerateLods()
+{
+	const uint32_t triangleCount = indices.Length() / 3;
+	if ( triangleCount < kMinLodTriangles )
+	{
+		return;
+	}
+	uint32_t targets[ kMaxLods - 1 ];
+	for ( uint32_t i = 0; i < kMaxLods - 1; i++ )
+	{
+		targets[ i ] = triangleCount >> ( i + 1 );
+	}
+	ae::Array< uint16_t > lodIndices[ kMaxLods - 1 ] = { TAG_RESOURCE, TAG_RESOURCE, TAG_RESOURCE };
+	uint32_t lodCount = 1 + SimplifyMesh( vertices.Begin(), vertices.Length(), indices.Begin(), indices.Length(), targets, kMaxLods - 1, lodIndices );
+	
+	// Each LOD gets a compacted copy of only the vertices it references
+	ae::Array< int32_t > remap = TAG_RESOURCE;
+	ae::Array< Vertex > lodVertices = TAG_RESOURCE;
+	for ( uint32_t lod = 1; lod < lodCount; lod++ )
+	{
+		ae::Array< uint16_t >& lodIndex = lodIndices[ lod - 1 ];
+		const uint32_t lodTriangles = lodIndex.Length() / 3;
+		if ( !lodTriangles || lodTriangles * 4 > m_lodTriangleCounts[ lod - 1 ] * 3 )
+		{
+			// Not enough of a reduction to be worth the memory
+			break;
+		}
+		remap.Clear();
+		for ( uint32_t i = 0; i < vertices.Length(); i++ )
+		{
+			remap.Append( -1 );
+		}
+		lodVertices.Clear();
+		for ( uint16_t& index : lodIndex )
+		{
+			if ( remap[ index ] < 0 )
+			{
+				remap[ index ] = lodVertices.Length();
+				lodVertices.Append( vertices[ index ] );
+			}
+			index = (uint16_t)remap[ index ];
+		}
+		m_gpuBytes += m_InitializeVertexData( &m_lodVertexData[ lod - 1 ], lodVertices.Begin(), lodVertices.Length(), lodIndex.Begin(), lodIndex.Length() );
+		m_lodTriangleCounts[ lod ] = lodTriangles;
+		m_lodCount = lod + 1;
+	}
+}
+
+uint32_t MeshResource::m_InitializeVertexData( ae::VertexData* vertexData, const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount )
+{
+	vertexData->Initialize( sizeof(Vertex), sizeof(uint16_t), vertexCount, indexCount, ae::VertexData::Primitive::Triangle, ae::VertexData::Usage::Static, ae::VertexData::Usage::Static );
+	vertexData->AddAttribute( "a_position", 4, ae::VertexData::Type::Float, offsetof( Vertex, pos ) );
+	vertexData->AddAttribute( "a_normal", 4, ae::VertexData::Type::Float, offsetof( Vertex, normal ) );
+	vertexData->AddAttribute( "a_color", 4, ae::VertexData::Type::Float, offsetof( Vertex, color ) );
+	vertexData->SetVertices( vertices, vertexCount );
+	vertexData->SetIndices( indices, indexCount );
+	return vertexCount * sizeof(Vertex) + indexCount * sizeof(uint16_t);
+}
+
+bool MeshResource::Load( ae::FileSystem* file, const char* filePath, ae::Array< Vertex >* verticesOut, ae::Array< uint16_t >* indicesOut )
 {
 	auto errFn = [&]()
 	{
@@ -102,77 +349,85 @@ void MeshResource::Initialize( ae::FileSystem* file, const char* filePath )
 	if ( !fileSize )
 	{
 		errFn();
-		return;
+		return false;
 	}
-	ae::Scratch< uint8_t > fileData( TAG_RESOURCE, fileSize );
-	if ( fileSize != file->Read( ae::FileSystem::Root::Data, filePath, fileData.Data(), fileSize ) )
+	// Not ae::Scratch, which is not safe to use from the background reload thread.
+	// Allocated and zero filled in one go, the contents are overwritten by Read().
+	ae::Array< uint8_t > fileData( TAG_RESOURCE, (uint8_t)0, fileSize );
+	if ( fileSize != file->Read( ae::FileSystem::Root::Data, filePath, fileData.Begin(), fileSize ) )
 	{
 		errFn();
-		return;
+		return false;
+	}
+	ofbx::IScene* scene = ofbx::load( (ofbx::u8*)fileData.Begin(), fileSize, (ofbx::u64)ofbx::LoadFlags::TRIANGULATE );
+	if ( !scene )
+	{
+		errFn();
+		return false;
+	}
+	
+	uint32_t meshCount = scene->getMeshCount();
+	
+	uint32_t totalVerts = 0;
+	uint32_t totalIndices = 0;
+	for ( uint32_t i = 0; i < meshCount; i++ )
+	{
+		const ofbx::Mesh* mesh = scene->getMesh( i );
+		const ofbx::Geometry* geo = mesh->getGeometry();
+		totalVerts += geo->getVertexCount();
+		totalIndices += geo->getIndexCount();
 	}
-	ofbx::IScene* scene = ofbx::load( (ofbx::u8*)fileData.Data(), fileSize, (ofbx::u64)ofbx::LoadFlags::TRIANGULATE );
-	if ( scene )
+	
+	uint32_t indexOffset = verticesOut->Length();
+	ae::Array< Vertex >& vertices = *verticesOut;
+	ae::Array< uint16_t >& indices = *indicesOut;
+	vertices.Reserve( vertices.Length() + totalVerts );
+	indices.Reserve( indices.Length() + totalIndices );
+	for ( uint32_t i = 0; i < meshCount; i++ )
 	{
-		uint32_t meshCount = scene->getMeshCount();
+		const ofbx::Mesh* mesh = scene->getMesh( i );
+		const ofbx::Geometry* geo = mesh->getGeometry();
+		ae::Matrix4 localToWorld = ofbxToAe( mesh->getGlobalTransform() );
+		ae::Matrix4 normalMatrix = localToWorld.GetNormalMatrix();
 		
-		uint32_t totalVerts = 0;
-		uint32_t totalIndices = 0;
-		for ( uint32_t i = 0; i < meshCount; i++ )
+		uint32_t vertexCount = geo->getVertexCount();
+		const ofbx::Vec3* meshVerts = geo->getVertices();
+		const ofbx::Vec3* meshNormals = geo->getNormals();
+		for ( uint32_t j = 0; j < vertexCount; j++ )
 		{
-			const ofbx::Mesh* mesh = scene->getMesh( i );
-			const ofbx::Geometry* geo = mesh->getGeometry();
-			totalVerts += geo->getVertexCount();
-			totalIndices += geo->getIndexCount();
+			ofbx::Vec3 p = meshVerts[ j ];
+			Vertex v;
+			v.pos.x = p.x;
+			v.pos.y = p.y;
+			v.pos.z = p.z;
+			v.pos.w = 1.0f;
+			v.pos = localToWorld * v.pos;
+			v.normal = ae::Vec4( 0.0f );
+			v.color = ae::Color::Gray().GetLinearRGBA();
+			vertices.Append( v );
 		}
 		
-		uint32_t indexOffset = 0;
-		ae::Array< Vertex > vertices( TAG_RESOURCE, totalVerts );
-		ae::Array< uint16_t > indices( TAG_RESOURCE, totalIndices );
-		for ( uint32_t i = 0; i < meshCount; i++ )
+		uint32_t indexCount = geo->getIndexCount();
+		const int32_t* meshIndices = geo->getFaceIndices();
+		for ( uint32_t j = 0; j < indexCount; j++ )
 		{
-			const ofbx::Mesh* mesh = scene->getMesh( i );
-			const ofbx::Geometry* geo = mesh->getGeometry();
-			ae::Matrix4 localToWorld = ofbxToAe( mesh->getGlobalTransform() );
-			ae::Matrix4 normalMatrix = localToWorld.GetNormalMatrix();
+			int32_t index = ( meshIndices[ j ] < 0 ) ? ( -meshIndices[ j ] - 1 ) : meshIndices[ j ];
+			AE_ASSERT( index < vertexCount );
+			index += indexOffset;
+			indices.Append( index );
 			
-			uint32_t vertexCount = geo->getVertexCount();
-			const ofbx::Vec3* meshVerts = geo->getVertices();
-			const ofbx::Vec3* meshNormals = geo->getNormals();
-			for ( uint32_t j = 0; j < vertexCount; j++ )
-			{
-				ofbx::Vec3 p = meshVerts[ j ];
-				Vertex v;
-				v.pos.x = p.x;
-				v.pos.y = p.y;
-				v.pos.z = p.z;
-				v.pos.w = 1.0f;
-				v.pos = localToWorld * v.pos;
-				v.normal = ae::Vec4( 0.0f );
-				v.color = ae::Color::Gray().GetLinearRGBA();
-				vertices.Append( v );
-			}
-			
-			uint32_t indexCount = geo->getIndexCount();
-			const int32_t* meshIndices = geo->getFaceIndices();
-			for ( uint32_t j = 0; j < indexCount; j++ )
-			{
-				int32_t index = ( meshIndices[ j ] < 0 ) ? ( -meshIndices[ j ] - 1 ) : meshIndices[ j ];
-				AE_ASSERT( index < vertexCount );
-				index += indexOffset;
-				indices.Append( index );
-				
-				ofbx::Vec3 n = meshNormals[ j ];
-				Vertex& v = vertices[ index ];
-				v.normal.x = n.x;
-				v.normal.y = n.y;
-				v.normal.z = n.z;
-				v.normal.w = 0.0f;
-				v.normal = normalMatrix * v.normal;
-				v.normal.SafeNormalize();
-			}
-			
-			indexOffset += vertexCount;
+			ofbx::Vec3 n = meshNormals[ j ];
+			Vertex& v = vertices[ index ];
+			v.normal.x = n.x;
+			v.normal.y = n.y;
+			v.normal.z = n.z;
+			v.normal.w = 0.0f;
+			v.normal = normalMatrix * v.normal;
+			v.normal.SafeNormalize();
 		}
-		Initialize( vertices.Begin(), indices.Begin(), vertices.Length(), indices.Length() );
+		
+		indexOffset += vertexCount;
 	}
+	scene->destroy();
+	return true;
 }
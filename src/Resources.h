@@ -19,6 +19,68 @@ struct Vertex
 extern const char* kVertShader;
 extern const char* kFragShader;
 
+//------------------------------------------------------------------------------
+// Uniforms
+//------------------------------------------------------------------------------
+enum class UniformId
+{
+	ModelToNdc,
+	NormalMatrix,
+	AmbientLight,
+	Color,
+	Count
+};
+extern const char* kUniformNames[ (uint32_t)UniformId::Count ];
+
+// Constant for every draw in a frame
+struct FrameUniforms
+{
+	ae::Matrix4 worldToNdc = ae::Matrix4::Identity();
+	ae::Vec3 ambientLight = ae::Vec3( 0.0f );
+};
+
+// Set for each draw
+struct ObjectUniforms
+{
+	ae::Matrix4 modelToNdc = ae::Matrix4::Identity();
+	ae::Matrix4 normalMatrix = ae::Matrix4::Identity();
+	ae::Vec3 color = ae::Vec3( 1.0f );
+};
+
+//------------------------------------------------------------------------------
+// UniformLayout class
+//------------------------------------------------------------------------------
+// Resolves which known uniforms a shader declares once at initialization. Frame
+// constants are converted and written once per frame into a list that is reused
+// for every draw, so per-object work is limited to overwriting ObjectUniforms.
+// aether has no uniform location handles, ae::UniformList is still keyed by name
+// and every uniform in it is sent again with each draw.
+class UniformLayout
+{
+public:
+	void Initialize( const char* vertShader, const char* fragShader );
+	void BeginFrame( const FrameUniforms& frame );
+	// The returned list is only valid until the next call
+	const ae::UniformList& Set( const ObjectUniforms& object );
+
+	const FrameUniforms& GetFrame() const { return m_frame; }
+	// CPU-side count of uniform data handed to draws since BeginFrame()
+	uint32_t GetFrameUploadBytes() const { return m_uploadBytes; }
+
+private:
+	bool m_used[ (uint32_t)UniformId::Count ] = {};
+	FrameUniforms m_frame;
+	ae::UniformList m_uniforms;
+	uint32_t m_frameBytes = 0;
+	uint32_t m_objectBytes = 0;
+	uint32_t m_uploadBytes = 0;
+};
+
+// Approximate radius in NDC of a sphere after projection, measured along the
+// world x axis which is always screen aligned for the top down camera. Returns 0
+// for spheres behind the camera.
+float GetProjectedRadius( const ae::Matrix4& worldToNdc, ae::Vec3 center, float radius );
+
 //------------------------------------------------------------------------------
 // Ship
 //------------------------------------------------------------------------------
@@ -34,13 +96,59 @@ extern const uint16_t kAsteroidIndices[ 6 ];
 //------------------------------------------------------------------------------
 // MeshResource class
 //------------------------------------------------------------------------------
+const ae::Tag TAG_RESOURCE = "resource";
+
 class MeshResource
 {
 public:
+	static constexpr uint32_t kMaxLods = 4;
+	
 	void Initialize( const Vertex* vertices, const uint16_t* indices, uint32_t vertexCount, uint32_t indexCount );
 	void Initialize( ae::FileSystem* file, const char* filePath );
+	// Takes the contents of the given arrays, used to swap in meshes loaded with
+	// Load(). Without upload only the CPU copies are kept, and there are no LODs.
+	void Initialize( ae::Array< Vertex >* vertices, ae::Array< uint16_t >* indices, bool upload = true );
+	void Terminate();
+	
+	// Appends the triangles in an fbx file to the given arrays. Does not use the
+	// graphics device so it is safe to call from a background thread.
+	static bool Load( ae::FileSystem* file, const char* filePath, ae::Array< Vertex >* verticesOut, ae::Array< uint16_t >* indicesOut );
+	// Data relative path for meshes loaded from a file, otherwise empty
+	const char* GetFilePath() const { return m_filePath.c_str(); }
+	
+	// Simplified versions of the mesh are generated at import. LOD 0 is the
+	// full resolution vertexData, each following LOD has about half as many
+	// triangles as the previous one.
+	uint32_t GetLodCount() const { return m_lodCount; }
+	const ae::VertexData& GetVertexData( uint32_t lod ) const;
+	uint32_t GetTriangleCount( uint32_t lod ) const;
+	// Distance from the mesh origin to the furthest vertex
+	float GetRadius() const { return m_radius; }
+	// Returns the LOD to draw at the given projected radius (see GetProjectedRadius()).
+	// Switching back to a finer LOD requires a slightly larger size than
+	// switching away from it so objects near a threshold don't flicker.
+	uint32_t SelectLod( float projectedRadius, uint32_t currentLod ) const;
+	// CPU copies plus the vertex and index buffers of every LOD
+	uint32_t GetMemoryBytes() const;
 	
 	ae::VertexData vertexData;
+	// CPU copies of the uploaded data, used for collision
+	ae::Array< Vertex > vertices = TAG_RESOURCE;
+	ae::Array< uint16_t > indices = TAG_RESOURCE;
+	
+private:
+	void m_Upload( bool upload );
+	void m_GenerateLods();
+	// Returns the size of the buffers in bytes
+	static uint32_t m_InitializeVertexData( ae::VertexData* vertexData, const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount );
+	ae::Str256 m_filePath;
+	bool m_uploaded = false;
+	
+	ae::VertexData m_lodVertexData[ kMaxLods - 1 ];
+	uint32_t m_lodTriangleCounts[ kMaxLods ] = {};
+	uint32_t m_lodCount = 0;
+	uint32_t m_gpuBytes = 0;
+	float m_radius = 0.0f;
 };
 
 #endif
@@ -0,0 +1,135 @@
+#include "Scenario.h"
+#include "Components.h"
+#include <cstdio>
+#include <cstring>
+
+//------------------------------------------------------------------------------
+// Scenario member functions
+//------------------------------------------------------------------------------
+bool Scenario::Load( ae::FileSystem* file, const char* path )
+{
+	m_entries.Clear();
+	uint32_t fileSize = file->GetSize( ae::FileSystem::Root::Data, path );
+	// Zero filled in one go, the extra byte terminates the text
+	ae::Array< char > text( TAG_GAME, (char)0, fileSize + 1 );
+	if ( !fileSize || fileSize != file->Read( ae::FileSystem::Root::Data, path, text.Begin(), fileSize ) )
+	{
+		AE_ERR( "Could not load scenario '#'", path );
+		return false;
+	}
+	
+	uint32_t lineNumber = 1;
+	char* line = text.Begin();
+	while ( *line )
+	{
+		char* next = line + strcspn( line, "\r\n" );
+		bool last = !*next;
+		*next = 0;
+		if ( char* comment = strchr( line, '#' ) )
+		{
+			*comment = 0;
+		}
+		if ( !m_ParseLine( line, lineNumber, path ) )
+		{
+			return false;
+		}
+		if ( last )
+		{
+			break;
+		}
+		line = next + 1;
+		lineNumber++;
+	}
+	return true;
+}
+
+void Scenario::Spawn( Game* game ) const
+{
+	for ( const Entry& entry : m_entries )
+	{
+		switch ( entry.archetype )
+		{
+			case Archetype::Level:
+			{
+				MeshHandle mesh = game->LoadMesh( entry.mesh.c_str() );
+				if ( !mesh.IsValid() )
+				{
+					AE_WARN( "Unknown level mesh '#'", entry.mesh.c_str() );
+					break;
+				}
+				ae::Matrix4 localToWorld = ae::Matrix4::Translation( ae::Vec3( entry.center.x, entry.center.y, 0.0f ) );
+				localToWorld *= ae::Matrix4::Scaling( ae::Vec3( entry.scale ) );
+				game->GetOrCreateLevel().AddMesh( &game->resources, mesh, localToWorld );
+				break;
+			}
+			case Archetype::Ship:
+				game->SpawnShips( entry.count, entry.center, entry.radius, entry.local, entry.teamId );
+				break;
+			case Archetype::Turret:
+				game->SpawnTurrets( entry.count, entry.center, entry.radius );
+				break;
+			case Archetype::Asteroid:
+				game->SpawnAsteroids( entry.count, entry.center, entry.radius );
+				break;
+		}
+	}
+	game->SpawnCamera();
+}
+
+bool Scenario::m_ParseLine( const char* line, uint32_t lineNumber, const char* path )
+{
+	char type[ 32 ] = {};
+	char arg[ 64 ] = {};
+	char flag[ 32 ] = {};
+	Entry entry;
+	if ( sscanf( line, "%31s", type ) != 1 )
+	{
+		return true; // Blank line
+	}
+	
+	bool valid = false;
+	if ( strcmp( type, "level" ) == 0 )
+	{
+		entry.archetype = Archetype::Level;
+		valid = sscanf( line, "%*s %63s %f %f %f", arg, &entry.center.x, &entry.center.y, &entry.scale ) == 4;
+		entry.mesh = arg;
+	}
+	else
+	{
+		if ( strcmp( type, "ship" ) == 0 )
+		{
+			entry.archetype = Archetype::Ship;
+			valid = true;
+		}
+		else if ( strcmp( type, "turret" ) == 0 )
+		{
+			entry.archetype = Archetype::Turret;
+			valid = true;
+		}
+		else if ( strcmp( type, "asteroid" ) == 0 )
+		{
+			entry.archetype = Archetype::Asteroid;
+			valid = true;
+		}
+		int fieldCount = sscanf( line, "%*s %u %f %f %f %31s", &entry.count, &entry.center.x, &entry.center.y, &entry.radius, flag );
+		valid = valid && fieldCount >= 4;
+		entry.local = ( fieldCount == 5 && strcmp( flag, "local" ) == 0 );
+		if ( fieldCount == 5 && strcmp( flag, "player" ) == 0 )
+		{
+			entry.teamId = TeamId::Player;
+		}
+	}
+	
+	if ( !valid )
+	{
+		AE_ERR( "#:# Could not parse '#'", path, lineNumber, line );
+		return false;
+	}
+	if ( entry.local && entry.count != 1 )
+	{
+		AE_ERR( "#:# Only one ship can be local, got # in '#'", path, lineNumber, entry.count, line );
+		return false;
+	}
+	m_entries.Append( entry );
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef ASTEROIDS_SCENARIO_H
+#define ASTEROIDS_SCENARIO_H
+
+#include "ae/aether.h"
+#include "Game.h"
+
+//------------------------------------------------------------------------------
+// Scenario class
+//------------------------------------------------------------------------------
+// Text description of a scene, one archetype per line. Everything after a '#'
+// is a comment. Entities are spread uniformly within radius of x,y.
+//
+//   level <mesh> <x> <y> <scale>
+//   ship <count> <x> <y> <radius> [local|player]
+//   turret <count> <x> <y> <radius>
+//   asteroid <count> <x> <y> <radius>
+//
+// A local ship line must have a count of 1. Ships other than the local one are
+// AI controlled and on the enemy team unless flagged player. Asteroids wrap
+// around the bounding box of every asteroid area. A camera is always added.
+class Scenario
+{
+public:
+	bool Load( ae::FileSystem* file, const char* path );
+	void Spawn( Game* game ) const;
+
+private:
+	enum class Archetype
+	{
+		Level,
+		Ship,
+		Turret,
+		Asteroid
+	};
+	struct Entry
+	{
+		Archetype archetype = Archetype::Level;
+		ae::Str64 mesh;
+		uint32_t count = 1;
+		ae::Vec2 center = ae::Vec2( 0.0f );
+		float radius = 0.0f;
+		float scale = 1.0f;
+		bool local = false;
+		TeamId teamId = TeamId::Enemy;
+	};
+	bool m_ParseLine( const char* line, uint32_t lineNumber, const char* path );
+	ae::Array< Entry > m_entries = TAG_GAME;
+};
+
+#endif
@@ -0,0 +1,347 @@
+#include "Simplify.h"
+#include <algorithm>
+#include <functional>
+
+//------------------------------------------------------------------------------
+// Quadric
+//------------------------------------------------------------------------------
+// Symmetric 4x4 error matrix, sum of squared distances to a set of planes
+struct Quadric
+{
+	void AddPlane( double a, double b, double c, double d )
+	{
+		m[ 0 ] += a * a; m[ 1 ] += a * b; m[ 2 ] += a * c; m[ 3 ] += a * d;
+		m[ 4 ] += b * b; m[ 5 ] += b * c; m[ 6 ] += b * d;
+		m[ 7 ] += c * c; m[ 8 ] += c * d;
+		m[ 9 ] += d * d;
+	}
+	void Add( const Quadric& other )
+	{
+		for ( uint32_t i = 0; i < 10; i++ )
+		{
+			m[ i ] += other.m[ i ];
+		}
+	}
+	double Evaluate( ae::Vec3 p ) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		return m[ 0 ] * x * x + 2.0 * m[ 1 ] * x * y + 2.0 * m[ 2 ] * x * z + 2.0 * m[ 3 ] * x
+			+ m[ 4 ] * y * y + 2.0 * m[ 5 ] * y * z + 2.0 * m[ 6 ] * y
+			+ m[ 7 ] * z * z + 2.0 * m[ 8 ] * z
+			+ m[ 9 ];
+	}
+	double m[ 10 ] = {};
+};
+
+//------------------------------------------------------------------------------
+// Simplifier
+//------------------------------------------------------------------------------
+class Simplifier
+{
+public:
+	Simplifier( const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount );
+	// Returns false if no more edges can be collapsed
+	bool Collapse( uint32_t targetTriangleCount );
+	void GetIndices( ae::Array< uint16_t >* indicesOut ) const;
+	uint32_t GetTriangleCount() const { return m_liveTriangles; }
+
+private:
+	struct Edge
+	{
+		double cost;
+		uint32_t keep;
+		uint32_t remove;
+		uint32_t keepVersion;
+		uint32_t removeVersion;
+		bool operator > ( const Edge& other ) const { return cost > other.cost; }
+	};
+	// Triangles using each vertex are singly linked lists in one array
+	struct TriLink
+	{
+		uint32_t tri;
+		uint32_t next;
+	};
+	static constexpr uint32_t kNoLink = ~0u;
+	void m_AddVertexTri( uint32_t v, uint32_t t );
+	void m_PushEdge( uint32_t a, uint32_t b );
+	bool m_PopEdge( Edge* edgeOut );
+	bool m_Flips( uint32_t keep, uint32_t remove ) const;
+	ae::Vec3 m_GetNormal( uint32_t t, uint32_t replace, uint32_t with ) const;
+
+	const Vertex* m_vertices;
+	ae::Array< uint32_t > m_weld = TAG_LOD; // Original vertex -> welded vertex (lowest original index at that position)
+	ae::Array< uint32_t > m_tris = TAG_LOD; // Welded vertex ids, 3 per triangle
+	ae::Array< uint32_t > m_corners = TAG_LOD; // Original vertex ids used for output, 3 per triangle
+	ae::Array< bool > m_triRemoved = TAG_LOD;
+	ae::Array< uint32_t > m_vertexTriHead = TAG_LOD; // First TriLink of each vertex
+	ae::Array< TriLink > m_triLinks = TAG_LOD;
+	ae::Array< Quadric > m_quadrics = TAG_LOD;
+	ae::Array< uint32_t > m_versions = TAG_LOD;
+	ae::Array< bool > m_vertexRemoved = TAG_LOD;
+	ae::Array< Edge > m_edges = TAG_LOD; // Min heap on cost
+	uint32_t m_liveTriangles = 0;
+};
+
+Simplifier::Simplifier( const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount )
+{
+	m_vertices = vertices;
+	
+	// Weld vertices that only differ by normal or color
+	ae::Array< uint32_t > order( TAG_LOD, vertexCount );
+	for ( uint32_t i = 0; i < vertexCount; i++ )
+	{
+		order.Append( i );
+	}
+	auto less = [ vertices ]( uint32_t a, uint32_t b )
+	{
+		const ae::Vec4& pa = vertices[ a ].pos;
+		const ae::Vec4& pb = vertices[ b ].pos;
+		if ( pa.x != pb.x )
+		{
+			return pa.x < pb.x;
+		}
+		if ( pa.y != pb.y )
+		{
+			return pa.y < pb.y;
+		}
+		if ( pa.z != pb.z )
+		{
+			return pa.z < pb.z;
+		}
+		return a < b;
+	};
+	std::sort( order.begin(), order.end(), less );
+	m_weld = ae::Array< uint32_t >( TAG_LOD, 0u, vertexCount );
+	for ( uint32_t i = 0; i < vertexCount; i++ )
+	{
+		const ae::Vec4& p = vertices[ order[ i ] ].pos;
+		bool same = i && p.x == vertices[ order[ i - 1 ] ].pos.x && p.y == vertices[ order[ i - 1 ] ].pos.y && p.z == vertices[ order[ i - 1 ] ].pos.z;
+		m_weld[ order[ i ] ] = same ? m_weld[ order[ i - 1 ] ] : order[ i ];
+	}
+	
+	const uint32_t triCount = indexCount / 3;
+	m_tris = ae::Array< uint32_t >( TAG_LOD, 0u, triCount * 3 );
+	m_corners.Reserve( triCount * 3 );
+	for ( uint32_t i = 0; i < triCount * 3; i++ )
+	{
+		m_corners.Append( indices[ i ] );
+	}
+	m_triRemoved = ae::Array< bool >( TAG_LOD, false, triCount );
+	m_vertexTriHead = ae::Array< uint32_t >( TAG_LOD, kNoLink, vertexCount );
+	m_triLinks.Reserve( triCount * 3 );
+	m_quadrics = ae::Array< Quadric >( TAG_LOD, Quadric(), vertexCount );
+	m_versions = ae::Array< uint32_t >( TAG_LOD, 0u, vertexCount );
+	m_vertexRemoved = ae::Array< bool >( TAG_LOD, false, vertexCount );
+	for ( uint32_t t = 0; t < triCount; t++ )
+	{
+		uint32_t* tri = &m_tris[ t * 3 ];
+		for ( uint32_t k = 0; k < 3; k++ )
+		{
+			tri[ k ] = m_weld[ indices[ t * 3 + k ] ];
+		}
+		if ( tri[ 0 ] == tri[ 1 ] || tri[ 1 ] == tri[ 2 ] || tri[ 2 ] == tri[ 0 ] )
+		{
+			m_triRemoved[ t ] = true;
+			continue;
+		}
+		m_liveTriangles++;
+		
+		ae::Vec3 p0 = vertices[ tri[ 0 ] ].pos.GetXYZ();
+		ae::Vec3 n = ( vertices[ tri[ 1 ] ].pos.GetXYZ() - p0 ).Cross( vertices[ tri[ 2 ] ].pos.GetXYZ() - p0 );
+		float area = n.SafeNormalize();
+		if ( area <= 0.0f )
+		{
+			n = ae::Vec3( 0.0f );
+		}
+		Quadric q;
+		q.AddPlane( n.x, n.y, n.z, -n.Dot( p0 ) );
+		for ( uint32_t k = 0; k < 3; k++ )
+		{
+			m_quadrics[ tri[ k ] ].Add( q );
+			m_AddVertexTri( tri[ k ], t );
+		}
+	}
+	
+	m_edges.Reserve( m_liveTriangles * 3 );
+	for ( uint32_t t = 0; t < triCount; t++ )
+	{
+		if ( !m_triRemoved[ t ] )
+		{
+			const uint32_t* tri = &m_tris[ t * 3 ];
+			// Each edge is pushed once per adjacent triangle, duplicates are harmless
+			m_PushEdge( tri[ 0 ], tri[ 1 ] );
+			m_PushEdge( tri[ 1 ], tri[ 2 ] );
+			m_PushEdge( tri[ 2 ], tri[ 0 ] );
+		}
+	}
+}
+
+bool Simplifier::Collapse( uint32_t targetTriangleCount )
+{
+	while ( m_liveTriangles > targetTriangleCount )
+	{
+		Edge edge;
+		if ( !m_PopEdge( &edge ) )
+		{
+			return false;
+		}
+		const uint32_t keep = edge.keep;
+		const uint32_t remove = edge.remove;
+		if ( m_vertexRemoved[ keep ] || m_vertexRemoved[ remove ]
+			|| m_versions[ keep ] != edge.keepVersion || m_versions[ remove ] != edge.removeVersion
+			|| m_Flips( keep, remove ) )
+		{
+			continue;
+		}
+		
+		m_vertexRemoved[ remove ] = true;
+		m_quadrics[ keep ].Add( m_quadrics[ remove ] );
+		m_versions[ keep ]++;
+		for ( uint32_t link = m_vertexTriHead[ remove ]; link != kNoLink; link = m_triLinks[ link ].next )
+		{
+			const uint32_t t = m_triLinks[ link ].tri;
+			if ( m_triRemoved[ t ] )
+			{
+				continue;
+			}
+			uint32_t* tri = &m_tris[ t * 3 ];
+			for ( uint32_t k = 0; k < 3; k++ )
+			{
+				if ( tri[ k ] == remove )
+				{
+					tri[ k ] = keep;
+					m_corners[ t * 3 + k ] = keep;
+				}
+			}
+			if ( tri[ 0 ] == tri[ 1 ] || tri[ 1 ] == tri[ 2 ] || tri[ 2 ] == tri[ 0 ] )
+			{
+				m_triRemoved[ t ] = true;
+				m_liveTriangles--;
+			}
+			else
+			{
+				m_AddVertexTri( keep, t );
+			}
+		}
+		m_vertexTriHead[ remove ] = kNoLink;
+		
+		// Costs of every edge touching the kept vertex changed
+		for ( uint32_t link = m_vertexTriHead[ keep ]; link != kNoLink; link = m_triLinks[ link ].next )
+		{
+			const uint32_t t = m_triLinks[ link ].tri;
+			if ( !m_triRemoved[ t ] )
+			{
+				const uint32_t* tri = &m_tris[ t * 3 ];
+				for ( uint32_t k = 0; k < 3; k++ )
+				{
+					if ( tri[ k ] != keep )
+					{
+						m_PushEdge( keep, tri[ k ] );
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void Simplifier::GetIndices( ae::Array< uint16_t >* indicesOut ) const
+{
+	indicesOut->Clear();
+	indicesOut->Reserve( m_liveTriangles * 3 );
+	const uint32_t triCount = m_triRemoved.Length();
+	for ( uint32_t t = 0; t < triCount; t++ )
+	{
+		if ( !m_triRemoved[ t ] )
+		{
+			indicesOut->Append( (uint16_t)m_corners[ t * 3 ] );
+			indicesOut->Append( (uint16_t)m_corners[ t * 3 + 1 ] );
+			indicesOut->Append( (uint16_t)m_corners[ t * 3 + 2 ] );
+		}
+	}
+}
+
+void Simplifier::m_AddVertexTri( uint32_t v, uint32_t t )
+{
+	m_triLinks.Append( { t, m_vertexTriHead[ v ] } );
+	m_vertexTriHead[ v ] = m_triLinks.Length() - 1;
+}
+
+void Simplifier::m_PushEdge( uint32_t a, uint32_t b )
+{
+	Quadric q = m_quadrics[ a ];
+	q.Add( m_quadrics[ b ] );
+	double costA = q.Evaluate( m_vertices[ a ].pos.GetXYZ() );
+	double costB = q.Evaluate( m_vertices[ b ].pos.GetXYZ() );
+	Edge edge;
+	edge.keep = ( costA <= costB ) ? a : b;
+	edge.remove = ( costA <= costB ) ? b : a;
+	edge.cost = ae::Min( costA, costB );
+	edge.keepVersion = m_versions[ edge.keep ];
+	edge.removeVersion = m_versions[ edge.remove ];
+	m_edges.Append( edge );
+	std::push_heap( m_edges.begin(), m_edges.end(), std::greater< Edge >() );
+}
+
+bool Simplifier::m_PopEdge( Edge* edgeOut )
+{
+	if ( !m_edges.Length() )
+	{
+		return false;
+	}
+	std::pop_heap( m_edges.begin(), m_edges.end(), std::greater< Edge >() );
+	*edgeOut = m_edges[ m_edges.Length() - 1 ];
+	m_edges.Remove( m_edges.Length() - 1 );
+	return true;
+}
+
+bool Simplifier::m_Flips( uint32_t keep, uint32_t remove ) const
+{
+	// Reject collapses that would turn a surviving triangle inside out
+	for ( uint32_t link = m_vertexTriHead[ remove ]; link != kNoLink; link = m_triLinks[ link ].next )
+	{
+		const uint32_t t = m_triLinks[ link ].tri;
+		const uint32_t* tri = &m_tris[ t * 3 ];
+		if ( m_triRemoved[ t ] || tri[ 0 ] == keep || tri[ 1 ] == keep || tri[ 2 ] == keep )
+		{
+			continue;
+		}
+		if ( m_GetNormal( t, remove, remove ).Dot( m_GetNormal( t, remove, keep ) ) <= 0.0f )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+ae::Vec3 Simplifier::m_GetNormal( uint32_t t, uint32_t replace, uint32_t with ) const
+{
+	ae::Vec3 p[ 3 ];
+	for ( uint32_t k = 0; k < 3; k++ )
+	{
+		uint32_t v = m_tris[ t * 3 + k ];
+		p[ k ] = m_vertices[ ( v == replace ) ? with : v ].pos.GetXYZ();
+	}
+	return ( p[ 1 ] - p[ 0 ] ).Cross( p[ 2 ] - p[ 0 ] );
+}
+
+//------------------------------------------------------------------------------
+// SimplifyMesh
+//------------------------------------------------------------------------------
+uint32_t SimplifyMesh( const Vertex* vertices, uint32_t vertexCount,
+	const uint16_t* indices, uint32_t indexCount,
+	const uint32_t* targetTriangleCounts, uint32_t targetCount,
+	ae::Array< uint16_t >* indicesOut )
+{
+	Simplifier simplifier( vertices, vertexCount, indices, indexCount );
+	for ( uint32_t i = 0; i < targetCount; i++ )
+	{
+		uint32_t prevCount = simplifier.GetTriangleCount();
+		if ( !simplifier.Collapse( targetTriangleCounts[ i ] ) && simplifier.GetTriangleCount() == prevCount )
+		{
+			return i;
+		}
+		simplifier.GetIndices( &indicesOut[ i ] );
+	}
+	return targetCount;
+}
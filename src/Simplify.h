@@ -0,0 +1,24 @@
+#ifndef ASTEROIDS_SIMPLIFY_H
+#define ASTEROIDS_SIMPLIFY_H
+
+#include "ae/aether.h"
+#include "Resources.h"
+
+const ae::Tag TAG_LOD = "lod";
+
+//------------------------------------------------------------------------------
+// SimplifyMesh
+//------------------------------------------------------------------------------
+// Progressively collapses edges in order of quadric error (Garland-Heckbert) and
+// writes an index buffer each time the triangle count reaches the next target.
+// Vertices are only ever collapsed onto existing vertices, so every output
+// references the original vertex buffer. Vertices sharing a position are
+// welded for the purposes of simplification. Returns the number of index
+// buffers written, which is less than targetCount when the mesh can't be
+// reduced any further.
+uint32_t SimplifyMesh( const Vertex* vertices, uint32_t vertexCount,
+	const uint16_t* indices, uint32_t indexCount,
+	const uint32_t* targetTriangleCounts, uint32_t targetCount,
+	ae::Array< uint16_t >* indicesOut );
+
+#endif
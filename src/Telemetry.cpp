@@ -0,0 +1,275 @@
+#include "Telemetry.h"
+#include <cstring>
+#if _AE_LINUX_ || _AE_APPLE_
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <cerrno>
+#endif
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
+//------------------------------------------------------------------------------
+// TelemetryCounter
+//------------------------------------------------------------------------------
+const char* kTelemetryCounterNames[] =
+{
+	"frame_us",
+	"simulate_us",
+	"ship_us",
+	"line_of_sight_us",
+	"turret_us",
+	"ai_us",
+	"asteroid_us",
+	"shooter_us",
+	"physics_us",
+	"collision_us",
+	"camera_us",
+	"events_us",
+	"commands_us",
+	"extract_us",
+	"render_us",
+	"input_latency_us",
+	"pacing_sleep_us",
+	"entities",
+	"physics_bodies",
+	"sleeping_bodies",
+	"models",
+	"ships",
+	"turrets",
+	"ai_ships",
+	"asteroids",
+	"projectiles",
+	"sim_lod_full",
+	"sim_lod_medium",
+	"sim_lod_far",
+	"projectiles_spawned",
+	"projectiles_killed",
+	"collision_tests",
+	"collision_hits",
+	"draw_calls",
+	"triangles",
+	"heap_allocations",
+};
+static_assert( sizeof(kTelemetryCounterNames) / sizeof(*kTelemetryCounterNames) == (uint32_t)TelemetryCounter::Count, "Missing telemetry counter names" );
+
+//------------------------------------------------------------------------------
+// Telemetry member functions
+//------------------------------------------------------------------------------
+bool Telemetry::Open( const char* path )
+{
+	Close();
+	if ( strncmp( path, "unix:", 5 ) == 0 )
+	{
+#if _AE_LINUX_ || _AE_APPLE_
+		sockaddr_un address;
+		memset( &address, 0, sizeof(address) );
+		address.sun_family = AF_UNIX;
+		strncpy( address.sun_path, path + 5, sizeof(address.sun_path) - 1 );
+		m_socket = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if ( m_socket < 0 || connect( m_socket, (sockaddr*)&address, sizeof(address) ) < 0 )
+		{
+			AE_WARN( "Could not connect to telemetry socket '#'", path + 5 );
+			Close();
+			return false;
+		}
+		fcntl( m_socket, F_SETFL, fcntl( m_socket, F_GETFL, 0 ) | O_NONBLOCK );
+#else
+		AE_WARN( "Telemetry sockets are not supported on this platform" );
+		return false;
+#endif
+	}
+	else
+	{
+		const uint32_t length = (uint32_t)strlen( path );
+		m_csv = length >= 4 && strcmp( path + length - 4, ".csv" ) == 0;
+		m_file = fopen( path, m_csv ? "w" : "wb" );
+		if ( !m_file )
+		{
+			AE_WARN( "Could not open telemetry file '#'", path );
+			return false;
+		}
+	}
+	
+	for ( uint32_t i = 0; i < kCounterCount; i++ )
+	{
+		m_isGauge[ i ] = false;
+		for ( ThreadCounters& thread : m_threads )
+		{
+			thread.values[ i ].store( 0, std::memory_order_relaxed );
+		}
+	}
+	m_frame = 0;
+	m_droppedFrames = 0;
+	m_startTime = ae::GetTime();
+	if ( m_csv )
+	{
+		fprintf( m_file, "frame,time" );
+		for ( const char* name : kTelemetryCounterNames )
+		{
+			fprintf( m_file, ",%s", name );
+		}
+		fprintf( m_file, "\n" );
+	}
+	else
+	{
+		TelemetryHeader header;
+		header.magic = kTelemetryMagic;
+		header.version = kTelemetryVersion;
+		header.counterCount = kCounterCount;
+		m_Write( &header, sizeof(header) );
+		for ( const char* name : kTelemetryCounterNames )
+		{
+			m_Write( name, (uint32_t)strlen( name ) + 1 );
+		}
+	}
+	AE_INFO( "Writing telemetry to '#'", path );
+	return true;
+}
+
+void Telemetry::Close()
+{
+	if ( m_file )
+	{
+		fclose( m_file );
+		m_file = nullptr;
+	}
+#if _AE_LINUX_ || _AE_APPLE_
+	if ( m_socket >= 0 )
+	{
+		m_Flush();
+		close( m_socket );
+	}
+#endif
+	m_socket = -1;
+	m_sendLength = 0;
+	if ( m_droppedFrames )
+	{
+		AE_WARN( "Telemetry dropped # frames", m_droppedFrames );
+		m_droppedFrames = 0;
+	}
+}
+
+void Telemetry::Add( TelemetryCounter counter, uint64_t value )
+{
+	if ( IsOpen() )
+	{
+		m_threads[ JobSystem::GetThreadIndex() ].values[ (uint32_t)counter ].fetch_add( value, std::memory_order_relaxed );
+	}
+}
+
+void Telemetry::Set( TelemetryCounter counter, uint64_t value )
+{
+	m_gauges[ (uint32_t)counter ] = value;
+	m_isGauge[ (uint32_t)counter ] = true;
+}
+
+void Telemetry::EndFrame()
+{
+	if ( !IsOpen() )
+	{
+		return;
+	}
+	
+	uint64_t values[ kCounterCount ];
+	for ( uint32_t i = 0; i < kCounterCount; i++ )
+	{
+		values[ i ] = 0;
+		for ( ThreadCounters& thread : m_threads )
+		{
+			values[ i ] += thread.values[ i ].exchange( 0, std::memory_order_relaxed );
+		}
+		if ( m_isGauge[ i ] )
+		{
+			values[ i ] = m_gauges[ i ];
+		}
+	}
+	
+	TelemetryFrame frame;
+	frame.frame = m_frame++;
+	frame.time = ae::GetTime() - m_startTime;
+	if ( m_csv )
+	{
+		fprintf( m_file, "%llu,%.6f", (unsigned long long)frame.frame, frame.time );
+		for ( uint64_t value : values )
+		{
+			fprintf( m_file, ",%llu", (unsigned long long)value );
+		}
+		fprintf( m_file, "\n" );
+	}
+	else if ( m_file )
+	{
+		m_Write( &frame, sizeof(frame) );
+		m_Write( values, sizeof(values) );
+	}
+	else if ( m_sendLength + sizeof(frame) + sizeof(values) <= kSendBufferSize )
+	{
+		m_Write( &frame, sizeof(frame) );
+		m_Write( values, sizeof(values) );
+		m_Flush();
+	}
+	else
+	{
+		m_droppedFrames++;
+		m_Flush();
+	}
+}
+
+void Telemetry::m_Write( const void* data, uint32_t size )
+{
+	if ( m_file )
+	{
+		fwrite( data, size, 1, m_file );
+	}
+	else if ( m_socket >= 0 )
+	{
+		AE_ASSERT( m_sendLength + size <= kSendBufferSize );
+		memcpy( m_sendBuffer + m_sendLength, data, size );
+		m_sendLength += size;
+	}
+}
+
+void Telemetry::m_Flush()
+{
+#if _AE_LINUX_ || _AE_APPLE_
+	if ( m_socket < 0 || !m_sendLength )
+	{
+		return;
+	}
+	ssize_t sent = send( m_socket, m_sendBuffer, m_sendLength, MSG_DONTWAIT | MSG_NOSIGNAL );
+	if ( sent < 0 )
+	{
+		if ( errno != EAGAIN && errno != EWOULDBLOCK )
+		{
+			AE_WARN( "Telemetry socket closed" );
+			close( m_socket );
+			m_socket = -1;
+			m_sendLength = 0;
+		}
+		return;
+	}
+	m_sendLength -= (uint32_t)sent;
+	memmove( m_sendBuffer, m_sendBuffer + sent, m_sendLength );
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Telemetry::Scope member functions
+//------------------------------------------------------------------------------
+Telemetry::Scope::Scope( Telemetry* telemetry, TelemetryCounter counter )
+{
+	m_telemetry = telemetry;
+	m_counter = counter;
+	m_start = telemetry->IsOpen() ? ae::GetTime() : 0.0;
+}
+
+Telemetry::Scope::~Scope()
+{
+	if ( m_telemetry->IsOpen() )
+	{
+		m_telemetry->Add( m_counter, (uint64_t)( ( ae::GetTime() - m_start ) * 1000000.0 ) );
+	}
+}
@@ -0,0 +1,120 @@
+#ifndef ASTEROIDS_TELEMETRY_H
+#define ASTEROIDS_TELEMETRY_H
+
+#include "ae/aether.h"
+#include "Jobs.h"
+#include "TelemetryFormat.h"
+#include <atomic>
+#include <cstdio>
+
+//------------------------------------------------------------------------------
+// TelemetryCounter
+//------------------------------------------------------------------------------
+enum class TelemetryCounter : uint32_t
+{
+	// Microseconds spent in each stage of the frame
+	FrameUs,
+	SimulateUs,
+	ShipUs,
+	LineOfSightUs,
+	TurretUs,
+	AiUs,
+	AsteroidUs,
+	ShooterUs,
+	PhysicsUs,
+	CollisionUs,
+	CameraUs,
+	EventsUs,
+	CommandsUs,
+	ExtractUs,
+	RenderUs,
+	// Microseconds from sampling input to presenting the tick that used it, and
+	// time slept before sampling input in low latency mode
+	InputLatencyUs,
+	PacingSleepUs,
+	// Entity counts at the end of the frame
+	Entities,
+	PhysicsBodies,
+	SleepingBodies,
+	Models,
+	Ships,
+	Turrets,
+	AiShips,
+	Asteroids,
+	Projectiles,
+	SimLodFull,
+	SimLodMedium,
+	SimLodFar,
+	// Totals for the frame
+	ProjectilesSpawned,
+	ProjectilesKilled,
+	CollisionTests,
+	CollisionHits,
+	DrawCalls,
+	Triangles,
+	// Heap allocations made by the frame, should be 0 once the game is warm
+	HeapAllocations,
+	Count
+};
+extern const char* kTelemetryCounterNames[ (uint32_t)TelemetryCounter::Count ];
+
+//------------------------------------------------------------------------------
+// Telemetry class
+//------------------------------------------------------------------------------
+// Per-frame counters streamed to a file or socket. Add() is lock free and can
+// be called from any thread, each job system thread increments its own cache
+// line. EndFrame() sums the threads and writes one record, so the cost of
+// recording is a relaxed atomic add per call and one small write per frame.
+// Everything is a no-op until Open() succeeds.
+class Telemetry
+{
+public:
+	// Path is a file, or "unix:<path>" for a stream socket that a reader is
+	// already listening on. Files ending in ".csv" are written as text.
+	bool Open( const char* path );
+	void Close();
+	bool IsOpen() const { return m_file || m_socket >= 0; }
+	
+	void Add( TelemetryCounter counter, uint64_t value = 1 );
+	// Gauges such as entity counts, must be called from the thread calling EndFrame()
+	void Set( TelemetryCounter counter, uint64_t value );
+	void EndFrame();
+	
+	// Adds the microseconds between construction and destruction to a counter
+	class Scope
+	{
+	public:
+		Scope( Telemetry* telemetry, TelemetryCounter counter );
+		~Scope();
+	private:
+		Telemetry* m_telemetry;
+		TelemetryCounter m_counter;
+		double m_start;
+	};
+
+private:
+	static const uint32_t kCounterCount = (uint32_t)TelemetryCounter::Count;
+	static const uint32_t kSendBufferSize = 16 * 1024;
+	void m_Write( const void* data, uint32_t size );
+	void m_Flush();
+	
+	struct alignas( 64 ) ThreadCounters
+	{
+		std::atomic< uint64_t > values[ kCounterCount ] = {};
+	};
+	ThreadCounters m_threads[ JobSystem::kMaxThreads ];
+	uint64_t m_gauges[ kCounterCount ] = {};
+	bool m_isGauge[ kCounterCount ] = {};
+	
+	FILE* m_file = nullptr;
+	bool m_csv = false;
+	int m_socket = -1;
+	// Socket writes never block, whole frames are dropped while the reader is behind
+	uint8_t m_sendBuffer[ kSendBufferSize ];
+	uint32_t m_sendLength = 0;
+	uint32_t m_droppedFrames = 0;
+	uint64_t m_frame = 0;
+	double m_startTime = 0.0;
+};
+
+#endif
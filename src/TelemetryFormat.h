@@ -0,0 +1,32 @@
+#ifndef ASTEROIDS_TELEMETRYFORMAT_H
+#define ASTEROIDS_TELEMETRYFORMAT_H
+
+#include <cstdint>
+
+//------------------------------------------------------------------------------
+// Telemetry stream format
+//------------------------------------------------------------------------------
+// Shared by the game and tools/TelemetryReader.cpp, so this header must not
+// depend on aether. A binary stream is, in native byte order:
+//   TelemetryHeader
+//   counterCount null terminated counter names
+//   One TelemetryFrame per frame, each followed by counterCount uint64_t values
+// The CSV variant is a row of column names ("frame,time,<counters>") followed
+// by one row per frame.
+const uint32_t kTelemetryMagic = 0x4C544541; // "AETL"
+const uint32_t kTelemetryVersion = 1;
+
+struct TelemetryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t counterCount;
+};
+
+struct TelemetryFrame
+{
+	uint64_t frame;
+	double time; // Seconds since the stream was opened
+};
+
+#endif
@@ -24,15 +24,39 @@
 // Headers
 //------------------------------------------------------------------------------
 #include "Game.h"
+#include "Memory.h"
+#include <cstring>
 
 //------------------------------------------------------------------------------
 // Main
 //------------------------------------------------------------------------------
-int main()
+int main( int argc, char* argv[] )
 {
+	ae::SetGlobalAllocator( &GetGameAllocator() );
 	Game game;
 	game.Initialize();
-	game.Load();
+	// Usage: ae-asteroids [--telemetry <file.bin|file.csv|unix:socket>] [--low-latency] [scenario]
+	// The scenario is a data relative file, eg. stress100k.scenario
+	const char* scenario = nullptr;
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "--telemetry" ) && i + 1 < argc )
+		{
+			game.telemetry.Open( argv[ ++i ] );
+		}
+		else if ( !strcmp( argv[ i ], "--low-latency" ) )
+		{
+			game.lowLatency = true;
+		}
+		else
+		{
+			scenario = argv[ i ];
+		}
+	}
+	if ( !scenario || !game.LoadScenario( scenario ) )
+	{
+		game.Load();
+	}
 	game.Run();
 	game.Terminate();
 	return 0;
@@ -0,0 +1,205 @@
+//------------------------------------------------------------------------------
+// TelemetryReader.cpp
+//------------------------------------------------------------------------------
+// Summarizes a telemetry stream written by the game (see Telemetry.h) with the
+// mean and percentiles of every counter. Reads binary or CSV streams from a
+// file, or from stdin when the path is "-", eg:
+//   nc -lU /tmp/asteroids.sock | ae-asteroids-telemetry -
+//
+// Usage: ae-asteroids-telemetry <file|-> [--skip <frames>]
+//------------------------------------------------------------------------------
+// Headers
+//------------------------------------------------------------------------------
+#include "TelemetryFormat.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Stream
+//------------------------------------------------------------------------------
+struct Stream
+{
+	std::vector< std::string > names;
+	std::vector< std::vector< uint64_t > > columns; // One per counter
+	uint32_t frameCount = 0;
+	double duration = 0.0;
+};
+
+static bool ReadBinary( FILE* file, Stream* stream )
+{
+	TelemetryHeader header;
+	if ( fread( &header, sizeof(header), 1, file ) != 1 || header.magic != kTelemetryMagic )
+	{
+		return false;
+	}
+	if ( header.version != kTelemetryVersion )
+	{
+		fprintf( stderr, "Unsupported telemetry version %u\n", header.version );
+		return false;
+	}
+	for ( uint32_t i = 0; i < header.counterCount; i++ )
+	{
+		std::string name;
+		int c;
+		while ( ( c = fgetc( file ) ) > 0 )
+		{
+			name.push_back( (char)c );
+		}
+		if ( c < 0 )
+		{
+			return false;
+		}
+		stream->names.push_back( name );
+	}
+	stream->columns.resize( header.counterCount );
+	
+	TelemetryFrame frame;
+	std::vector< uint64_t > values( header.counterCount );
+	// A stream cut off mid frame just loses its last frame
+	while ( fread( &frame, sizeof(frame), 1, file ) == 1
+		&& fread( values.data(), sizeof(uint64_t), values.size(), file ) == values.size() )
+	{
+		for ( uint32_t i = 0; i < header.counterCount; i++ )
+		{
+			stream->columns[ i ].push_back( values[ i ] );
+		}
+		stream->frameCount++;
+		stream->duration = frame.time;
+	}
+	return true;
+}
+
+static bool ReadCsv( FILE* file, Stream* stream )
+{
+	char line[ 4096 ];
+	if ( !fgets( line, sizeof(line), file ) || strncmp( line, "frame,time,", 11 ) != 0 )
+	{
+		return false;
+	}
+	for ( char* name = strtok( line + 11, ",\r\n" ); name; name = strtok( nullptr, ",\r\n" ) )
+	{
+		stream->names.push_back( name );
+	}
+	stream->columns.resize( stream->names.size() );
+	while ( fgets( line, sizeof(line), file ) )
+	{
+		char* cursor = line;
+		strtoull( cursor, &cursor, 10 ); // Frame
+		if ( *cursor != ',' )
+		{
+			break;
+		}
+		double time = strtod( cursor + 1, &cursor );
+		uint32_t count = 0;
+		for ( ; count < stream->names.size() && *cursor == ','; count++ )
+		{
+			stream->columns[ count ].push_back( strtoull( cursor + 1, &cursor, 10 ) );
+		}
+		if ( count != stream->names.size() )
+		{
+			// Partial last row
+			for ( uint32_t i = 0; i < count; i++ )
+			{
+				stream->columns[ i ].pop_back();
+			}
+			break;
+		}
+		stream->frameCount++;
+		stream->duration = time;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Statistics
+//------------------------------------------------------------------------------
+// Nearest rank percentile of sorted values
+static uint64_t Percentile( const std::vector< uint64_t >& sorted, double p )
+{
+	size_t rank = (size_t)( p * sorted.size() + 0.999999 );
+	rank = std::min( std::max( rank, (size_t)1 ), sorted.size() );
+	return sorted[ rank - 1 ];
+}
+
+static void PrintSummary( const Stream& stream, uint32_t skip )
+{
+	printf( "%u frames over %.2fs, skipped %u\n", stream.frameCount, stream.duration, skip );
+	printf( "%-22s %12s %10s %10s %10s %10s %10s\n", "counter", "mean", "p50", "p90", "p99", "p99.9", "max" );
+	for ( size_t i = 0; i < stream.names.size(); i++ )
+	{
+		std::vector< uint64_t > sorted( stream.columns[ i ].begin() + skip, stream.columns[ i ].end() );
+		if ( sorted.empty() )
+		{
+			continue;
+		}
+		std::sort( sorted.begin(), sorted.end() );
+		double sum = 0.0;
+		for ( uint64_t value : sorted )
+		{
+			sum += (double)value;
+		}
+		printf( "%-22s %12.1f %10llu %10llu %10llu %10llu %10llu\n",
+			stream.names[ i ].c_str(),
+			sum / sorted.size(),
+			(unsigned long long)Percentile( sorted, 0.5 ),
+			(unsigned long long)Percentile( sorted, 0.9 ),
+			(unsigned long long)Percentile( sorted, 0.99 ),
+			(unsigned long long)Percentile( sorted, 0.999 ),
+			(unsigned long long)sorted.back()
+		);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Main
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+	const char* path = nullptr;
+	uint32_t skip = 0;
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "--skip" ) && i + 1 < argc )
+		{
+			skip = (uint32_t)atoi( argv[ ++i ] );
+		}
+		else
+		{
+			path = argv[ i ];
+		}
+	}
+	if ( !path )
+	{
+		fprintf( stderr, "Usage: %s <file|-> [--skip <frames>]\n", argv[ 0 ] );
+		return 1;
+	}
+	
+	FILE* file = strcmp( path, "-" ) ? fopen( path, "rb" ) : stdin;
+	if ( !file )
+	{
+		fprintf( stderr, "Could not open '%s'\n", path );
+		return 1;
+	}
+	// Binary streams start with the magic number, anything else is treated as CSV
+	int first = fgetc( file );
+	ungetc( first, file );
+	Stream stream;
+	bool success = ( first == ( kTelemetryMagic & 0xFF ) ) ? ReadBinary( file, &stream ) : ReadCsv( file, &stream );
+	if ( file != stdin )
+	{
+		fclose( file );
+	}
+	if ( !success )
+	{
+		fprintf( stderr, "'%s' is not a telemetry stream\n", path );
+		return 1;
+	}
+	
+	skip = std::min( skip, stream.frameCount );
+	PrintSummary( stream, skip );
+	return 0;
+}